@@ -8,16 +8,52 @@
 
 .equ VRAM_MAX_ADDR,     76800
 
+.equ VRAM_WIDTH,        320
+
+.equ VRAM_HEIGHT,       240
+
 .equ STORE_OPCODE,      0x02
 
+.equ EXT_OPCODE,        0x00
+
+.equ EXT_COORDENADAS,   0x01
+
+.equ EXT_ROLAGEM,       0x02
+
+.equ EXT_BASE,          0x03
+
+.equ EXT_VERSAO,        0x04
+
+.equ EXT_REPETICAO,     0x05
+
+.equ REPETICAO_MAXIMA,  8
+
+.equ EXT_PAGINA_ESCRITA, 0x06
+
+.equ EXT_APRESENTAR,    0x07
+
+.equ STREAM_OPCODE,     0x01
+
+.equ PIXELS_POR_PALAVRA, 3
+
 .equ FLAG_DONE_MASK,    0x01
 
 .equ FLAG_ERROR_MASK,   0x02
 
-.equ FLAG_ZOOM_Max_MASK,   0x03
+.equ FLAG_ZOOM_Max_MASK,   0x08
 
 .equ FLAG_ZOOM_Min_MASK,   0x04
 
+.equ FLAG_V2_MASK,      0x10
+
+.equ FLAG_PAGINAS_MASK, 0x20
+
+.equ FLAG_TROCA_MASK,   0x40
+
+.equ FLAG_ROLAGEM_MASK, 0x80
+
+.equ ESPERA_TROCA,      0x40000  @ leituras de PIO_FLAGS: cobre mais de um quadro da VGA
+
 .equ TIMEOUT_COUNT,     0x0
 
 
@@ -40,6 +76,14 @@ FPGA_ADRS:
 
     .space 4
 
+PROTOCOLO:
+
+    .word 1                  @ protocolo em uso: 1 até Detectar_Protocolo encontrar o v2
+
+CONFIRMADOS:
+
+    .word 0                  @ pixels confirmados pela última escrita de fluxo ou retângulo
+
 FILE_DESCRIPTOR:
 
     .space 4
@@ -243,7 +287,7 @@ write_pixel:
     bne     .WAIT_LOOP
 
     # Timeout
-    mov     r0, #0
+    mov     r0, #-2
     b       .EXIT
 .CHECK_ERROR:
     tst     r2, #FLAG_ERROR_MASK
@@ -261,6 +305,469 @@ write_pixel:
     pop     {r4-r6, pc}
 .size write_pixel, .-write_pixel
 
+@ Recorta o retângulo (r4=x, r5=y, r6=w, r7=h) contra a VRAM 320x240.
+@ Avança a origem r8 (passo de linha r9) pelas colunas/linhas descartadas.
+@ Retorna r0 = 0 se nada sobrou para escrever, 1 caso contrário.
+.type clip_rect, %function
+clip_rect:
+    cmp     r4, #0
+    bge     .CLIP_Y0
+    sub     r8, r8, r4           @ origem avança -x colunas
+    add     r6, r6, r4           @ w += x
+    mov     r4, #0
+.CLIP_Y0:
+    cmp     r5, #0
+    bge     .CLIP_X1
+    mul     r0, r5, r9
+    sub     r8, r8, r0           @ origem avança -y linhas
+    add     r7, r7, r5           @ h += y
+    mov     r5, #0
+.CLIP_X1:
+    mov     r0, #VRAM_WIDTH
+    sub     r0, r0, r4           @ colunas disponíveis a partir de x
+    cmp     r6, r0
+    ble     .CLIP_Y1
+    mov     r6, r0
+.CLIP_Y1:
+    mov     r0, #VRAM_HEIGHT
+    sub     r0, r0, r5           @ linhas disponíveis a partir de y
+    cmp     r7, r0
+    ble     .CLIP_CHECK
+    mov     r7, r0
+.CLIP_CHECK:
+    mov     r0, #0
+    cmp     r6, #0
+    ble     .CLIP_RET
+    cmp     r7, #0
+    ble     .CLIP_RET
+    mov     r0, #1
+.CLIP_RET:
+    bx      lr
+.size clip_rect, .-clip_rect
+
+.global write_rect
+.type write_rect, %function
+write_rect:
+    push    {r4-r12, lr}
+    mov     r4, r0               @ dst_x
+    mov     r5, r1               @ dst_y
+    mov     r6, r2               @ w
+    mov     r7, r3               @ h
+    ldr     r8, [sp, #40]        @ src
+    ldr     r9, [sp, #44]        @ src_stride
+    bl      clip_rect
+    cmp     r0, #0
+    beq     .WR_VAZIO
+    mov     r0, #VRAM_WIDTH
+    mla     r11, r5, r0, r4      @ endereço = y * 320 + x
+    mov     r5, #0               @ pixels confirmados
+    ldr     r0, =PROTOCOLO
+    ldr     r0, [r0]
+    cmp     r0, #2
+    beq     .WR_V2
+.WR_ROW:
+    mov     r4, r8
+    mov     r10, r6
+.WR_PIXEL:
+    mov     r0, r11
+    ldrb    r1, [r4], #1
+    bl      write_pixel
+    cmp     r0, #0
+    bne     .WR_FIM              @ para no primeiro erro
+    add     r5, r5, #1
+    add     r11, r11, #1
+    subs    r10, r10, #1
+    bne     .WR_PIXEL
+    add     r8, r8, r9           @ próxima linha da origem
+    add     r11, r11, #VRAM_WIDTH
+    sub     r11, r11, r6         @ próxima linha da VRAM
+    subs    r7, r7, #1
+    bne     .WR_ROW
+    mov     r0, #0
+.WR_FIM:
+    ldr     r1, =CONFIRMADOS
+    str     r5, [r1]
+    pop     {r4-r12, pc}
+.WR_VAZIO:
+    mov     r5, #0
+    b       .WR_FIM
+.WR_V2:
+    cmp     r6, #VRAM_WIDTH      @ linhas inteiras e contíguas na origem:
+    bne     .WR_V2_ROW           @ um único fluxo para o retângulo todo
+    cmp     r9, #VRAM_WIDTH
+    bne     .WR_V2_ROW
+    mul     r6, r7, r6
+    mov     r7, #1
+.WR_V2_ROW:
+    mov     r0, r11
+    mov     r1, r8
+    mov     r2, r6
+    bl      write_stream
+    cmp     r0, #0
+    bne     .WR_V2_FALHA
+    add     r5, r5, r6
+    add     r8, r8, r9
+    add     r11, r11, #VRAM_WIDTH
+    subs    r7, r7, #1
+    bne     .WR_V2_ROW
+    mov     r0, #0
+    b       .WR_FIM
+.WR_V2_FALHA:
+    ldr     r1, =CONFIRMADOS     @ soma o que o fluxo da linha confirmou
+    ldr     r1, [r1]
+    add     r5, r5, r1
+    b       .WR_FIM
+.size write_rect, .-write_rect
+
+.global fill_rect
+.type fill_rect, %function
+fill_rect:
+    push    {r4-r12, lr}
+    mov     r4, r0               @ x
+    mov     r5, r1               @ y
+    mov     r6, r2               @ w
+    mov     r7, r3               @ h
+    ldr     r12, [sp, #40]       @ value
+    mov     r8, #0
+    mov     r9, #0
+    bl      clip_rect
+    cmp     r0, #0
+    beq     .FR_VAZIO
+    and     r9, r12, #0xFF       @ valor fica em registrador preservado
+    mov     r0, #VRAM_WIDTH
+    mla     r11, r5, r0, r4      @ endereço = y * 320 + x
+    mov     r5, #0               @ pixels confirmados
+    ldr     r0, =PROTOCOLO
+    ldr     r0, [r0]
+    cmp     r0, #2
+    beq     .FR_V2
+.FR_ROW:
+    mov     r10, r6
+.FR_PIXEL:
+    mov     r0, r11
+    mov     r1, r9
+    bl      write_pixel
+    cmp     r0, #0
+    bne     .FR_FIM              @ para no primeiro erro
+    add     r5, r5, #1
+    add     r11, r11, #1
+    subs    r10, r10, #1
+    bne     .FR_PIXEL
+    add     r11, r11, #VRAM_WIDTH
+    sub     r11, r11, r6
+    subs    r7, r7, #1
+    bne     .FR_ROW
+    mov     r0, #0
+.FR_FIM:
+    ldr     r1, =CONFIRMADOS
+    str     r5, [r1]
+    pop     {r4-r12, pc}
+.FR_VAZIO:
+    mov     r5, #0
+    b       .FR_FIM
+.FR_V2:
+    sub     sp, sp, #VRAM_WIDTH  @ uma linha com o valor, usada como origem do fluxo
+    mov     r0, #0
+.FR_V2_FILL:
+    strb    r9, [sp, r0]
+    add     r0, r0, #1
+    cmp     r0, r6
+    blt     .FR_V2_FILL
+.FR_V2_ROW:
+    mov     r0, r11
+    mov     r1, sp
+    mov     r2, r6
+    bl      write_stream
+    cmp     r0, #0
+    bne     .FR_V2_FALHA
+    add     r5, r5, r6
+    add     r11, r11, #VRAM_WIDTH
+    subs    r7, r7, #1
+    bne     .FR_V2_ROW
+    add     sp, sp, #VRAM_WIDTH
+    mov     r0, #0
+    b       .FR_FIM
+.FR_V2_FALHA:
+    add     sp, sp, #VRAM_WIDTH
+    ldr     r1, =CONFIRMADOS     @ soma o que o fluxo da linha confirmou
+    ldr     r1, [r1]
+    add     r5, r5, r1
+    b       .FR_FIM
+.size fill_rect, .-fill_rect
+
+@ Envia r2 como instrução (r4 = base do PIO) e espera DONE.
+@ Retorna r0 = 0, -2 (TIMEOUT) ou -3 (HW_ERROR). Altera r2 e r3.
+.type enviar_e_esperar, %function
+enviar_e_esperar:
+    str     r2, [r4, #PIO_INSTRUCT]
+    dmb     sy
+    mov     r2, #1
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r2, #0
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r3, #0x3000
+.EE_WAIT:
+    ldr     r2, [r4, #PIO_FLAGS]
+    tst     r2, #FLAG_DONE_MASK
+    bne     .EE_CHECK
+    subs    r3, r3, #1
+    bne     .EE_WAIT
+    mov     r0, #-2
+    bx      lr
+.EE_CHECK:
+    mov     r0, #0
+    tst     r2, #FLAG_ERROR_MASK
+    beq     .EE_RET
+    mov     r0, #-3
+.EE_RET:
+    bx      lr
+.size enviar_e_esperar, .-enviar_e_esperar
+
+.global write_stream
+.type write_stream, %function
+write_stream:
+    mov     r3, #1               @ sem repetição
+    b       write_stream_rep
+.size write_stream, .-write_stream
+
+.global write_stream_rep
+.type write_stream_rep, %function
+write_stream_rep:
+    push    {r4-r10, lr}
+    ldr     r4, =FPGA_ADRS
+    ldr     r4, [r4]
+    mov     r5, r1               @ origem
+    mov     r6, r2               @ pixels restantes
+    mov     r10, r2              @ pixels pedidos
+    mov     r9, r3               @ repetição de cada pixel
+    cmp     r9, #1
+    blt     .WS_INVALID
+    cmp     r9, #REPETICAO_MAXIMA
+    bgt     .WS_INVALID
+    cmp     r6, #0
+    ble     .WS_OK
+    mul     r3, r6, r9
+    add     r3, r0, r3
+    ldr     r7, =VRAM_MAX_ADDR
+    cmp     r3, r7
+    bhi     .WS_INVALID          @ o fluxo passaria do fim da VRAM
+    lsl     r2, r0, #6           @ [22:6] = endereço base
+    orr     r2, r2, #(EXT_BASE << 3)
+    bl      enviar_e_esperar
+    cmp     r0, #0
+    bne     .WS_EXIT
+    cmp     r9, #1
+    beq     .WS_WORD             @ EXT_BASE já deixa a repetição em 1
+    sub     r2, r9, #1
+    lsl     r2, r2, #6           @ [8:6] = repetição - 1
+    orr     r2, r2, #(EXT_REPETICAO << 3)
+    bl      enviar_e_esperar
+    cmp     r0, #0
+    bne     .WS_EXIT
+.WS_WORD:
+    mov     r7, #PIXELS_POR_PALAVRA
+    cmp     r6, #PIXELS_POR_PALAVRA
+    bge     .WS_PACK
+    mov     r7, r6               @ última palavra, parcial
+.WS_PACK:
+    ldrb    r8, [r5]
+    lsl     r2, r8, #3           @ [10:3] = pixel 0
+    orr     r2, r2, #STREAM_OPCODE
+    cmp     r7, #2
+    blt     .WS_COUNT
+    ldrb    r8, [r5, #1]
+    orr     r2, r2, r8, lsl #11  @ [18:11] = pixel 1
+    cmp     r7, #3
+    blt     .WS_COUNT
+    ldrb    r8, [r5, #2]
+    orr     r2, r2, r8, lsl #19  @ [26:19] = pixel 2
+.WS_COUNT:
+    sub     r8, r7, #1
+    orr     r2, r2, r8, lsl #27  @ [28:27] = pixels válidos - 1
+    bl      enviar_e_esperar
+    cmp     r0, #0
+    bne     .WS_EXIT
+    add     r5, r5, r7
+    subs    r6, r6, r7
+    bne     .WS_WORD
+.WS_OK:
+    mov     r0, #0
+.WS_EXIT:
+    sub     r1, r10, r6          @ pixels das palavras confirmadas
+    mul     r1, r9, r1           @ já com a repetição
+    ldr     r2, =CONFIRMADOS
+    str     r1, [r2]
+    pop     {r4-r10, pc}
+.WS_INVALID:
+    mov     r6, r10              @ nada confirmado
+    mov     r0, #-1
+    b       .WS_EXIT
+.size write_stream_rep, .-write_stream_rep
+
+.global Detectar_Protocolo
+.type Detectar_Protocolo, %function
+Detectar_Protocolo:
+    push    {r4, lr}
+    ldr     r4, =FPGA_ADRS
+    ldr     r4, [r4]
+    mov     r2, #(EXT_VERSAO << 3)
+    str     r2, [r4, #PIO_INSTRUCT]
+    dmb     sy
+    mov     r2, #1
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r2, #0
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r3, #0x3000
+.DP_WAIT:
+    ldr     r2, [r4, #PIO_FLAGS]
+    tst     r2, #FLAG_V2_MASK    @ hardware v2 responde com o bit de versão
+    bne     .DP_V2
+    subs    r3, r3, #1
+    bne     .DP_WAIT
+    mov     r0, #1               @ sem resposta: protocolo v1
+    b       .DP_SAVE
+.DP_V2:
+    mov     r0, #2
+.DP_SAVE:
+    ldr     r1, =PROTOCOLO
+    str     r0, [r1]
+    pop     {r4, pc}
+.size Detectar_Protocolo, .-Detectar_Protocolo
+
+.global Definir_Protocolo
+.type Definir_Protocolo, %function
+Definir_Protocolo:
+    ldr     r1, =PROTOCOLO
+    str     r0, [r1]
+    bx      lr
+.size Definir_Protocolo, .-Definir_Protocolo
+
+.global Pixels_Confirmados
+.type Pixels_Confirmados, %function
+Pixels_Confirmados:
+    ldr     r0, =CONFIRMADOS
+    ldr     r0, [r0]
+    bx      lr
+.size Pixels_Confirmados, .-Pixels_Confirmados
+
+.global Detectar_Paginas
+.type Detectar_Paginas, %function
+Detectar_Paginas:
+    push    {r4, lr}
+    ldr     r4, =FPGA_ADRS
+    ldr     r4, [r4]
+    mov     r2, #(EXT_VERSAO << 3)
+    str     r2, [r4, #PIO_INSTRUCT]
+    dmb     sy
+    mov     r2, #1
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r2, #0
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r3, #0x3000
+    mov     r0, #1               @ sem resposta: uma página
+.DG_WAIT:
+    ldr     r2, [r4, #PIO_FLAGS]
+    tst     r2, #FLAG_V2_MASK
+    bne     .DG_V2
+    subs    r3, r3, #1
+    bne     .DG_WAIT
+    b       .DG_EXIT
+.DG_V2:
+    tst     r2, #FLAG_PAGINAS_MASK  @ as duas flags chegam na mesma resposta
+    beq     .DG_EXIT
+    mov     r0, #2
+.DG_EXIT:
+    pop     {r4, pc}
+.size Detectar_Paginas, .-Detectar_Paginas
+
+.global Detectar_Rolagem
+.type Detectar_Rolagem, %function
+Detectar_Rolagem:
+    push    {r4, lr}
+    ldr     r4, =FPGA_ADRS
+    ldr     r4, [r4]
+    mov     r2, #(EXT_VERSAO << 3)
+    str     r2, [r4, #PIO_INSTRUCT]
+    dmb     sy
+    mov     r2, #1
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r2, #0
+    str     r2, [r4, #PIO_ENABLE]
+    mov     r3, #0x3000
+    mov     r0, #0               @ sem resposta: sem rolagem
+.DR_WAIT:
+    ldr     r2, [r4, #PIO_FLAGS]
+    tst     r2, #FLAG_V2_MASK
+    bne     .DR_V2
+    subs    r3, r3, #1
+    bne     .DR_WAIT
+    b       .DR_EXIT
+.DR_V2:
+    tst     r2, #FLAG_ROLAGEM_MASK  @ chega na mesma resposta que FLAG_V2_MASK
+    beq     .DR_EXIT
+    mov     r0, #1
+.DR_EXIT:
+    pop     {r4, pc}
+.size Detectar_Rolagem, .-Detectar_Rolagem
+
+.global Definir_Pagina_Escrita
+.type Definir_Pagina_Escrita, %function
+Definir_Pagina_Escrita:
+    push    {r4, lr}
+    ldr     r4, =FPGA_ADRS
+    ldr     r4, [r4]
+    and     r0, r0, #1
+    lsl     r2, r0, #6           @ [6] = página
+    orr     r2, r2, #(EXT_PAGINA_ESCRITA << 3)
+    bl      enviar_e_esperar
+    pop     {r4, pc}
+.size Definir_Pagina_Escrita, .-Definir_Pagina_Escrita
+
+.global Apresentar_Pagina
+.type Apresentar_Pagina, %function
+Apresentar_Pagina:
+    push    {r4, lr}
+    bl      Solicitar_Pagina
+    cmp     r0, #0
+    bne     .AP_EXIT
+    bl      Esperar_Troca
+.AP_EXIT:
+    pop     {r4, pc}
+.size Apresentar_Pagina, .-Apresentar_Pagina
+
+.global Solicitar_Pagina
+.type Solicitar_Pagina, %function
+Solicitar_Pagina:
+    push    {r4, lr}
+    ldr     r4, =FPGA_ADRS
+    ldr     r4, [r4]
+    and     r0, r0, #1
+    lsl     r2, r0, #6           @ [6] = página
+    and     r1, r1, #1
+    orr     r2, r2, r1, lsl #7   @ [7] = rolagem volta a (0, 0) na troca
+    orr     r2, r2, #(EXT_APRESENTAR << 3)
+    bl      enviar_e_esperar
+    pop     {r4, pc}
+.size Solicitar_Pagina, .-Solicitar_Pagina
+
+.global Esperar_Troca
+.type Esperar_Troca, %function
+Esperar_Troca:
+    ldr     r1, =FPGA_ADRS
+    ldr     r1, [r1]
+    ldr     r3, =ESPERA_TROCA
+    mov     r0, #0
+.ET_WAIT:
+    ldr     r2, [r1, #PIO_FLAGS]
+    tst     r2, #FLAG_TROCA_MASK    @ limpa no retraço vertical, com a página já trocada
+    beq     .ET_EXIT
+    subs    r3, r3, #1
+    bne     .ET_WAIT
+    mov     r0, #-2
+.ET_EXIT:
+    bx      lr
+.size Esperar_Troca, .-Esperar_Troca
+
 .global Vizinho_Prox
 .type Vizinho_Prox, %function
 Vizinho_Prox:
@@ -436,4 +943,49 @@ Flag_Min:
     and     r0, r0, #FLAG_ZOOM_Min_MASK   
     
     pop     {r7, pc}
-.size Flag_Min, .-Flag_Min
\ No newline at end of file
+.size Flag_Min, .-Flag_Min
+.global Enviar_Coordenadas
+.type Enviar_Coordenadas, %function
+Enviar_Coordenadas:
+    push    {r7, lr}
+    ldr     r3, =FPGA_ADRS
+    ldr     r3, [r3]
+    mov     r2, #(EXT_COORDENADAS << 3)   @ [2:0] = 0 (estendida), [5:3] = sub-código
+    lsl     r0, r0, #22
+    lsr     r0, r0, #16                   @ [15:6] = x (10 bits)
+    orr     r2, r2, r0
+    lsl     r1, r1, #23
+    lsr     r1, r1, #7                    @ [24:16] = y (9 bits)
+    orr     r2, r2, r1
+    str     r2, [r3, #PIO_INSTRUCT]
+    dmb     sy
+    movs    r2, #1
+    str     r2, [r3, #PIO_ENABLE]
+    movs    r2, #0
+    str     r2, [r3, #PIO_ENABLE]
+    mov     r0, #0
+    pop     {r7, pc}
+.size Enviar_Coordenadas, .-Enviar_Coordenadas
+
+.global Definir_Rolagem
+.type Definir_Rolagem, %function
+Definir_Rolagem:
+    push    {r7, lr}
+    ldr     r3, =FPGA_ADRS
+    ldr     r3, [r3]
+    mov     r2, #(EXT_ROLAGEM << 3)       @ [2:0] = 0 (estendida), [5:3] = sub-código
+    lsl     r0, r0, #23
+    lsr     r0, r0, #17                   @ [14:6] = coluna inicial (9 bits)
+    orr     r2, r2, r0
+    and     r1, r1, #0xFF
+    lsl     r1, r1, #15                   @ [22:15] = linha inicial (8 bits)
+    orr     r2, r2, r1
+    str     r2, [r3, #PIO_INSTRUCT]
+    dmb     sy
+    movs    r2, #1
+    str     r2, [r3, #PIO_ENABLE]
+    movs    r2, #0
+    str     r2, [r3, #PIO_ENABLE]
+    mov     r0, #0
+    pop     {r7, pc}
+.size Definir_Rolagem, .-Definir_Rolagem
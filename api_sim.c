@@ -0,0 +1,593 @@
+// Modelo em software do bloco de registradores do coprocessador (PIO_INSTRUCT,
+// PIO_ENABLE e PIO_FLAGS) e da VRAM, exportando a mesma API de api.s.
+// Cada função monta as instruções com o mesmo empacotamento de bits do Assembly e
+// as entrega pelos registradores; o modelo executa a instrução na borda de subida de
+// PIO_ENABLE. Permite rodar o programa e medir o tráfego no barramento sem a placa.
+//
+// Variáveis de ambiente:
+//   SIM_PROTOCOLO  versão do hardware simulado: 1 ou 2 (padrão 2)
+//   SIM_NS_ACESSO  custo estimado de cada acesso a registrador na ponte LW (padrão 150 ns)
+//   SIM_TELA       arquivo PGM onde a imagem exibida é gravada ao encerrar
+//   SIM_TEMPO_REAL se definida, cada acesso dura SIM_NS_ACESSO de fato (tempos medidos
+//                  pelo programa passam a refletir o barramento)
+//   SIM_FALHA_ERRO     probabilidade de uma instrução de escrita terminar com ERROR sem gravar
+//   SIM_FALHA_TIMEOUT  probabilidade de uma instrução se perder (DONE não sobe)
+//   SIM_FALHA_TRAVA    probabilidade de um erro injetado travar a escrita até o próximo Reset
+//   SIM_SEMENTE        semente das falhas injetadas (padrão 1)
+//   SIM_PAGINAS    páginas da VRAM no hardware v2: 1 ou 2 (padrão 2); a troca de página
+//                  acontece no retraço vertical, modelado a cada 16,7 ms de tempo de barramento
+//   SIM_ROLAGEM    se 0, a VGA do hardware v2 ignora EXT_ROLAGEM (padrão 1; o v1 nunca rola)
+//   SIM_BITS_FLAGS largura do PIO_FLAGS (padrão PIO_FLAGS_DATA_WIDTH de hps_0.h, 4 bits);
+//                  com 4 bits o HPS não enxerga V2, PAGINAS, TROCA nem ROLAGEM, como na placa
+#define _XOPEN_SOURCE 500
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "header.h"
+#include "hps_0.h"
+
+#define NUM_REGISTRADORES (0x40 / 4)
+#define NIVEL_ZOOM_MAXIMO 3
+#define PERIODO_QUADRO_NS (1e9 / 60.0)   // VGA a 60 Hz
+#define FLAGS_PERSISTENTES (FLAG_V2_MASK | FLAG_PAGINAS_MASK | FLAG_TROCA_MASK | FLAG_ROLAGEM_MASK)
+
+// Estado do hardware simulado
+static uint32_t registradores[NUM_REGISTRADORES];
+static unsigned char vram[2][VRAM_MAX_ADDR];
+static int versao_hw = 2;
+static int paginas_hw = 2;
+static int rolagem_hw = 1;
+static int pagina_escrita = 0, pagina_exibida = 0;
+static int pagina_pendente = -1;      // pedida por EXT_APRESENTAR, espera o retraço
+static int zerar_rolagem_pendente = 0;
+static double pedido_troca_ns = 0.0;
+static unsigned int endereco_fluxo = 0;
+static int repeticao = 1;
+static int rolagem_x = 0, rolagem_y = 0;
+static int nivel_zoom = 0;
+static int bits_flags = PIO_FLAGS_DATA_WIDTH;   // bits de PIO_FLAGS que chegam ao HPS
+
+// Falhas injetadas
+static double prob_erro = 0.0, prob_timeout = 0.0, prob_trava = 0.0;
+static unsigned int semente = 1;
+static int travado = 0;
+
+// Estado da API (equivalente às variáveis PROTOCOLO e CONFIRMADOS de api.s)
+static int protocolo = 1;
+static int confirmados = 0;
+static double ns_por_acesso = 150.0;
+static int tempo_real = 0;
+static double atraso_pendente_ns = 0.0;
+
+// Contadores do tráfego no barramento
+static struct {
+    long acessos;
+    long instrucoes;
+    long instrucoes_escrita;
+    long pixels;
+    long erros;
+    long perdidas;
+    long escritas_visiveis;   // pixels gravados na página em exibição (sujeitos a tearing)
+    long trocas;
+    double espera_troca_ns;
+} estat;
+
+// ================= MODELO DO HARDWARE =================
+
+// Grava um pixel na VRAM simulada; endereço fora da faixa é erro de hardware
+static int gravar_vram(unsigned int endereco, unsigned char valor) {
+    if (endereco >= VRAM_MAX_ADDR) {
+        return -1;
+    }
+    vram[pagina_escrita][endereco] = valor;
+    estat.pixels++;
+    if (pagina_escrita == pagina_exibida) {
+        estat.escritas_visiveis++;
+    }
+    return 0;
+}
+
+static int sortear(double probabilidade) {
+    return probabilidade > 0.0 && rand_r(&semente) < probabilidade * ((double)RAND_MAX + 1.0);
+}
+
+// Decodifica e executa uma instrução, atualizando PIO_FLAGS
+static void executar_instrucao(uint32_t instr) {
+    uint32_t flags = registradores[PIO_FLAGS / 4] & FLAGS_PERSISTENTES;
+    unsigned int opcode = instr & 0x7;
+    int escrita = opcode == STORE_OPCODE || (opcode == STREAM_OPCODE && versao_hw >= 2);
+    int erro = 0;
+
+    estat.instrucoes++;
+
+    // Instrução perdida na ponte: DONE fica baixo até o próximo pulso
+    if (sortear(prob_timeout)) {
+        estat.perdidas++;
+        return;
+    }
+
+    if (opcode == 7) {
+        travado = 0;
+    } else if (escrita && (travado || sortear(prob_erro))) {
+        if (!travado && sortear(prob_trava)) {
+            travado = 1;
+        }
+        erro = 1;   // nada é gravado
+    }
+
+    if (!erro) {
+        switch (opcode) {
+            case EXT_OPCODE: {
+                unsigned int sub = (instr >> 3) & 0x7;
+                if (rolagem_hw && sub == EXT_ROLAGEM) {
+                    rolagem_x = ((instr >> 6) & 0x1FF) % VRAM_WIDTH;
+                    rolagem_y = ((instr >> 15) & 0xFF) % VRAM_HEIGHT;
+                } else if (versao_hw >= 2 && sub == EXT_BASE) {
+                    endereco_fluxo = (instr >> 6) & 0x1FFFF;
+                    repeticao = 1;
+                } else if (versao_hw >= 2 && sub == EXT_REPETICAO) {
+                    repeticao = ((instr >> 6) & 0x7) + 1;
+                } else if (versao_hw >= 2 && sub == EXT_VERSAO) {
+                    flags |= FLAG_V2_MASK;
+                    if (paginas_hw == 2) flags |= FLAG_PAGINAS_MASK;
+                    if (rolagem_hw) flags |= FLAG_ROLAGEM_MASK;
+                } else if (versao_hw >= 2 && paginas_hw == 2 && sub == EXT_PAGINA_ESCRITA) {
+                    pagina_escrita = (instr >> 6) & 0x1;
+                } else if (versao_hw >= 2 && paginas_hw == 2 && sub == EXT_APRESENTAR) {
+                    pagina_pendente = (instr >> 6) & 0x1;
+                    zerar_rolagem_pendente = (instr >> 7) & 0x1;
+                    pedido_troca_ns = estat.acessos * ns_por_acesso;
+                    flags |= FLAG_TROCA_MASK;
+                }
+                // EXT_COORDENADAS só move o cursor na VGA; nada a modelar
+                break;
+            }
+
+            case STREAM_OPCODE: {
+                // Opcode desconhecido no hardware v1: ignorado
+                if (versao_hw < 2) break;
+                int n = ((instr >> 27) & 0x3) + 1;
+                if (n > PIXELS_POR_PALAVRA) {
+                    erro = 1;
+                    break;
+                }
+                estat.instrucoes_escrita++;
+                for (int i = 0; i < n * repeticao && !erro; i++) {
+                    erro = gravar_vram(endereco_fluxo++, (instr >> (3 + 8 * (i / repeticao))) & 0xFF) != 0;
+                }
+                break;
+            }
+
+            case STORE_OPCODE:
+                estat.instrucoes_escrita++;
+                erro = gravar_vram((instr >> 3) & 0x1FFFF, (instr >> 21) & 0xFF) != 0;
+                break;
+
+            case 3: // Vizinho Próximo
+            case 4: // Replicação
+                if (nivel_zoom < NIVEL_ZOOM_MAXIMO) nivel_zoom++;
+                break;
+
+            case 5: // Média
+            case 6: // Decimação
+                if (nivel_zoom > 0) nivel_zoom--;
+                break;
+
+            case 7: // Reset
+                nivel_zoom = 0;
+                break;
+        }
+    }
+
+    if (erro) {
+        flags |= FLAG_ERROR_MASK;
+        estat.erros++;
+    }
+    if (nivel_zoom == 0) {
+        flags |= FLAG_ZOOM_Min_MASK;
+    } else if (nivel_zoom == NIVEL_ZOOM_MAXIMO) {
+        flags |= FLAG_ZOOM_Max_MASK;
+    }
+    registradores[PIO_FLAGS / 4] = flags | FLAG_DONE_MASK;
+}
+
+// Faz a troca de página pendente quando o relógio do barramento cruza um retraço vertical
+static void verificar_retraco() {
+    if (pagina_pendente < 0) return;
+
+    double agora = estat.acessos * ns_por_acesso;
+    if ((long)(agora / PERIODO_QUADRO_NS) == (long)(pedido_troca_ns / PERIODO_QUADRO_NS)) {
+        return;
+    }
+    pagina_exibida = pagina_pendente;
+    pagina_pendente = -1;
+    if (zerar_rolagem_pendente) {
+        rolagem_x = rolagem_y = 0;
+        zerar_rolagem_pendente = 0;
+    }
+    registradores[PIO_FLAGS / 4] &= ~FLAG_TROCA_MASK;
+    estat.trocas++;
+    estat.espera_troca_ns += agora - pedido_troca_ns;
+}
+
+// Contabiliza um acesso; em tempo real, dorme a cada 100 us de barramento acumulados
+static void contar_acesso() {
+    estat.acessos++;
+    verificar_retraco();
+    if (!tempo_real) return;
+
+    atraso_pendente_ns += ns_por_acesso;
+    if (atraso_pendente_ns >= 100000.0) {
+        struct timespec ts = { 0, (long)atraso_pendente_ns };
+        nanosleep(&ts, NULL);
+        atraso_pendente_ns = 0.0;
+    }
+}
+
+// Escrita em registrador vinda do HPS; a borda de subida de PIO_ENABLE dispara a instrução
+static void escrever_registrador(unsigned int offset, uint32_t valor) {
+    contar_acesso();
+    if (offset == PIO_ENABLE && valor != 0 && registradores[PIO_ENABLE / 4] == 0) {
+        registradores[PIO_FLAGS / 4] &= ~FLAG_DONE_MASK;
+        executar_instrucao(registradores[PIO_INSTRUCT / 4]);
+    }
+    registradores[offset / 4] = valor;
+}
+
+static uint32_t ler_registrador(unsigned int offset) {
+    contar_acesso();
+    if (offset == PIO_FLAGS) {
+        return registradores[offset / 4] & (uint32_t)((1ull << bits_flags) - 1);
+    }
+    return registradores[offset / 4];
+}
+
+// ================= API (mesmo comportamento de api.s) =================
+
+// Grava a instrução e gera o pulso em PIO_ENABLE
+static void enviar_instrucao(uint32_t instr) {
+    escrever_registrador(PIO_INSTRUCT, instr);
+    escrever_registrador(PIO_ENABLE, 1);
+    escrever_registrador(PIO_ENABLE, 0);
+}
+
+// Espera DONE como o laço .WAIT_LOOP: 0, -2 (TIMEOUT) ou -3 (HW_ERROR)
+static int esperar_conclusao() {
+    for (int i = 0x3000; i > 0; i--) {
+        uint32_t flags = ler_registrador(PIO_FLAGS);
+        if (flags & FLAG_DONE_MASK) {
+            return (flags & FLAG_ERROR_MASK) ? -3 : 0;
+        }
+    }
+    return -2;
+}
+
+int iniciarBib() {
+    const char *valor;
+
+    memset(registradores, 0, sizeof(registradores));
+    memset(vram, 0, sizeof(vram));
+    memset(&estat, 0, sizeof(estat));
+    registradores[PIO_FLAGS / 4] = FLAG_DONE_MASK | FLAG_ZOOM_Min_MASK;
+    pagina_escrita = pagina_exibida = 0;
+    pagina_pendente = -1;
+
+    if ((valor = getenv("SIM_PROTOCOLO")) != NULL) {
+        versao_hw = atoi(valor) >= 2 ? 2 : 1;
+    }
+    if ((valor = getenv("SIM_PAGINAS")) != NULL) {
+        paginas_hw = atoi(valor) >= 2 ? 2 : 1;
+    }
+    if ((valor = getenv("SIM_ROLAGEM")) != NULL) {
+        rolagem_hw = atoi(valor) != 0;
+    }
+    if ((valor = getenv("SIM_BITS_FLAGS")) != NULL) {
+        bits_flags = atoi(valor);
+        if (bits_flags < 1) bits_flags = 1;
+        if (bits_flags > 32) bits_flags = 32;
+    }
+    if (versao_hw < 2) {
+        paginas_hw = 1;
+        rolagem_hw = 0;
+    }
+    if ((valor = getenv("SIM_FALHA_ERRO")) != NULL) {
+        prob_erro = atof(valor);
+    }
+    if ((valor = getenv("SIM_FALHA_TIMEOUT")) != NULL) {
+        prob_timeout = atof(valor);
+    }
+    if ((valor = getenv("SIM_FALHA_TRAVA")) != NULL) {
+        prob_trava = atof(valor);
+    }
+    if ((valor = getenv("SIM_SEMENTE")) != NULL) {
+        semente = (unsigned int)atoi(valor);
+    }
+    travado = 0;
+    if ((valor = getenv("SIM_NS_ACESSO")) != NULL) {
+        ns_por_acesso = atof(valor);
+    }
+    tempo_real = getenv("SIM_TEMPO_REAL") != NULL;
+
+    printf("🧪 SIMULADOR: hardware com protocolo v%d, %d página(s) de VRAM, %s rolagem, PIO_FLAGS com %d bits\n",
+           versao_hw, paginas_hw, rolagem_hw ? "com" : "sem", bits_flags);
+    return 0;
+}
+
+// Grava a imagem como a VGA a exibiria (com a rolagem aplicada) em PGM
+static void gravar_tela(const char *arquivo) {
+    FILE *f = fopen(arquivo, "wb");
+    if (!f) {
+        printf("ERRO: Não foi possível criar '%s'\n", arquivo);
+        return;
+    }
+    fprintf(f, "P5\n%d %d\n255\n", VRAM_WIDTH, VRAM_HEIGHT);
+    for (int y = 0; y < VRAM_HEIGHT; y++) {
+        int linha = (y + rolagem_y) % VRAM_HEIGHT;
+        for (int x = 0; x < VRAM_WIDTH; x++) {
+            fputc(vram[pagina_exibida][linha * VRAM_WIDTH + (x + rolagem_x) % VRAM_WIDTH], f);
+        }
+    }
+    fclose(f);
+}
+
+int encerrarBib() {
+    const char *tela = getenv("SIM_TELA");
+
+    printf("\n📊 SIMULADOR: hardware v%d, protocolo em uso v%d\n", versao_hw, protocolo);
+    printf("   Instruções: %ld (%ld de escrita, %ld com erro, %ld perdidas)\n",
+           estat.instrucoes, estat.instrucoes_escrita, estat.erros, estat.perdidas);
+    printf("   Pixels gravados: %ld (%.2f por instrução de escrita)\n", estat.pixels,
+           estat.instrucoes_escrita ? (double)estat.pixels / estat.instrucoes_escrita : 0.0);
+    printf("   Acessos ao barramento: %ld (~%.1f ms a %.0f ns/acesso)\n",
+           estat.acessos, estat.acessos * ns_por_acesso / 1e6, ns_por_acesso);
+
+    printf("   Pixels gravados na página em exibição: %ld\n", estat.escritas_visiveis);
+    if (estat.trocas > 0) {
+        printf("   Trocas de página: %ld (espera média pelo retraço: %.2f ms)\n",
+               estat.trocas, estat.espera_troca_ns / estat.trocas / 1e6);
+    }
+
+    if (tela != NULL) {
+        gravar_tela(tela);
+        printf("   Tela gravada em '%s'\n", tela);
+    }
+    return 0;
+}
+
+int write_pixel(unsigned int address, unsigned char data) {
+    if (address >= VRAM_MAX_ADDR) {
+        return -1;
+    }
+    enviar_instrucao(STORE_OPCODE | (address << 3) | (1u << 20) | ((uint32_t)data << 21));
+    return esperar_conclusao();
+}
+
+int write_stream_rep(unsigned int address, const unsigned char *src, int n, int fator) {
+    confirmados = 0;
+    if (fator < 1 || fator > REPETICAO_MAXIMA) {
+        return -1;
+    }
+    if (n <= 0) {
+        return 0;
+    }
+    if (address + (unsigned int)(n * fator) > VRAM_MAX_ADDR) {
+        return -1;
+    }
+
+    enviar_instrucao(EXT_OPCODE | (EXT_BASE << 3) | (address << 6));
+    int status = esperar_conclusao();
+
+    // EXT_BASE já deixa a repetição em 1
+    if (status == 0 && fator > 1) {
+        enviar_instrucao(EXT_OPCODE | (EXT_REPETICAO << 3) | ((uint32_t)(fator - 1) << 6));
+        status = esperar_conclusao();
+    }
+
+    while (status == 0 && n > 0) {
+        int k = n < PIXELS_POR_PALAVRA ? n : PIXELS_POR_PALAVRA;
+        uint32_t instr = STREAM_OPCODE | ((uint32_t)(k - 1) << 27);
+        for (int i = 0; i < k; i++) {
+            instr |= (uint32_t)src[i] << (3 + 8 * i);
+        }
+        enviar_instrucao(instr);
+        status = esperar_conclusao();
+        if (status == 0) {
+            confirmados += k * fator;
+        }
+        src += k;
+        n -= k;
+    }
+    return status;
+}
+
+int write_stream(unsigned int address, const unsigned char *src, int n) {
+    return write_stream_rep(address, src, n, 1);
+}
+
+// Recorte contra a VRAM 320x240, como clip_rect em api.s
+static int recortar_retangulo(int *x, int *y, int *w, int *h, const unsigned char **src, int stride) {
+    if (*x < 0) {
+        *src -= *x;
+        *w += *x;
+        *x = 0;
+    }
+    if (*y < 0) {
+        *src -= (long)*y * stride;
+        *h += *y;
+        *y = 0;
+    }
+    if (*w > VRAM_WIDTH - *x) *w = VRAM_WIDTH - *x;
+    if (*h > VRAM_HEIGHT - *y) *h = VRAM_HEIGHT - *y;
+    return *w > 0 && *h > 0;
+}
+
+int write_rect(int dst_x, int dst_y, int w, int h, const unsigned char *src, int src_stride) {
+    int feitos = 0, status;
+
+    confirmados = 0;
+    if (!recortar_retangulo(&dst_x, &dst_y, &w, &h, &src, src_stride)) {
+        return 0;
+    }
+
+    unsigned int endereco = dst_y * VRAM_WIDTH + dst_x;
+
+    if (protocolo == 2) {
+        // Linhas inteiras e contíguas na origem: um único fluxo para o retângulo todo
+        if (w == VRAM_WIDTH && src_stride == VRAM_WIDTH) {
+            w *= h;
+            h = 1;
+        }
+        for (int y = 0; y < h; y++, src += src_stride, endereco += VRAM_WIDTH) {
+            if ((status = write_stream(endereco, src, w)) != 0) {
+                confirmados += feitos;
+                return status;
+            }
+            feitos += w;
+        }
+        confirmados = feitos;
+        return 0;
+    }
+
+    for (int y = 0; y < h; y++, src += src_stride, endereco += VRAM_WIDTH) {
+        for (int x = 0; x < w; x++) {
+            if ((status = write_pixel(endereco + x, src[x])) != 0) {
+                confirmados = feitos;
+                return status;
+            }
+            feitos++;
+        }
+    }
+    confirmados = feitos;
+    return 0;
+}
+
+int fill_rect(int x, int y, int w, int h, unsigned char value) {
+    const unsigned char *nada = NULL;
+    unsigned char linha[VRAM_WIDTH];
+    int feitos = 0, status;
+
+    confirmados = 0;
+    if (!recortar_retangulo(&x, &y, &w, &h, &nada, 0)) {
+        return 0;
+    }
+
+    unsigned int endereco = y * VRAM_WIDTH + x;
+    memset(linha, value, w);
+
+    for (int j = 0; j < h; j++, endereco += VRAM_WIDTH) {
+        if (protocolo == 2) {
+            if ((status = write_stream(endereco, linha, w)) != 0) {
+                confirmados += feitos;
+                return status;
+            }
+            feitos += w;
+        } else {
+            for (int i = 0; i < w; i++) {
+                if ((status = write_pixel(endereco + i, value)) != 0) {
+                    confirmados = feitos;
+                    return status;
+                }
+                feitos++;
+            }
+        }
+    }
+    confirmados = feitos;
+    return 0;
+}
+
+int Pixels_Confirmados() {
+    return confirmados;
+}
+
+int Detectar_Protocolo() {
+    enviar_instrucao(EXT_OPCODE | (EXT_VERSAO << 3));
+
+    protocolo = 1;
+    for (int i = 0x3000; i > 0; i--) {
+        if (ler_registrador(PIO_FLAGS) & FLAG_V2_MASK) {
+            protocolo = 2;
+            break;
+        }
+    }
+    return protocolo;
+}
+
+void Definir_Protocolo(int versao) {
+    protocolo = versao;
+}
+
+int Detectar_Paginas() {
+    enviar_instrucao(EXT_OPCODE | (EXT_VERSAO << 3));
+
+    for (int i = 0x3000; i > 0; i--) {
+        uint32_t flags = ler_registrador(PIO_FLAGS);
+        if (flags & FLAG_V2_MASK) {
+            return (flags & FLAG_PAGINAS_MASK) ? 2 : 1;
+        }
+    }
+    return 1;
+}
+
+int Detectar_Rolagem() {
+    enviar_instrucao(EXT_OPCODE | (EXT_VERSAO << 3));
+
+    for (int i = 0x3000; i > 0; i--) {
+        uint32_t flags = ler_registrador(PIO_FLAGS);
+        if (flags & FLAG_V2_MASK) {
+            return (flags & FLAG_ROLAGEM_MASK) != 0;
+        }
+    }
+    return 0;
+}
+
+int Definir_Pagina_Escrita(int pagina) {
+    enviar_instrucao(EXT_OPCODE | (EXT_PAGINA_ESCRITA << 3) | ((uint32_t)(pagina & 1) << 6));
+    return esperar_conclusao();
+}
+
+int Solicitar_Pagina(int pagina, int zerar_rolagem) {
+    enviar_instrucao(EXT_OPCODE | (EXT_APRESENTAR << 3) | ((uint32_t)(pagina & 1) << 6) |
+                     ((uint32_t)(zerar_rolagem & 1) << 7));
+    return esperar_conclusao();
+}
+
+// Espera a troca como o laço .ET_WAIT: FLAG_TROCA_MASK cai no retraço vertical
+int Esperar_Troca() {
+    for (int i = 0x40000; i > 0; i--) {
+        if (!(ler_registrador(PIO_FLAGS) & FLAG_TROCA_MASK)) {
+            return 0;
+        }
+    }
+    return -2;
+}
+
+int Apresentar_Pagina(int pagina, int zerar_rolagem) {
+    int status = Solicitar_Pagina(pagina, zerar_rolagem);
+    return status != 0 ? status : Esperar_Troca();
+}
+
+int Enviar_Coordenadas(int x, int y) {
+    enviar_instrucao(EXT_OPCODE | (EXT_COORDENADAS << 3) |
+                     ((uint32_t)(x & 0x3FF) << 6) | ((uint32_t)(y & 0x1FF) << 16));
+    return 0;
+}
+
+int Definir_Rolagem(int x, int y) {
+    enviar_instrucao(EXT_OPCODE | (EXT_ROLAGEM << 3) |
+                     ((uint32_t)(x & 0x1FF) << 6) | ((uint32_t)(y & 0xFF) << 15));
+    return 0;
+}
+
+void Vizinho_Prox() { enviar_instrucao(3); }
+void Replicacao()   { enviar_instrucao(4); }
+void Media()        { enviar_instrucao(5); }
+void Decimacao()    { enviar_instrucao(6); }
+void Reset()        { enviar_instrucao(7); }
+
+int Flag_Done()  { return ler_registrador(PIO_FLAGS) & FLAG_DONE_MASK; }
+int Flag_Error() { return ler_registrador(PIO_FLAGS) & FLAG_ERROR_MASK; }
+int Flag_Max()   { return ler_registrador(PIO_FLAGS) & FLAG_ZOOM_Max_MASK; }
+int Flag_Min()   { return ler_registrador(PIO_FLAGS) & FLAG_ZOOM_Min_MASK; }
@@ -8,9 +8,32 @@
 
 // Constantes de Controle e Status
 #define VRAM_MAX_ADDR 76800   // Endereço máximo da VRAM (0x4B00)
+#define VRAM_WIDTH    320     // Largura da imagem na VRAM
+#define VRAM_HEIGHT   240     // Altura da imagem na VRAM
 #define STORE_OPCODE  0x02    // Opcode para operação de escrita/armazenamento
+#define EXT_OPCODE    0x00    // Opcode das instruções estendidas (sub-código nos bits 5:3)
+#define EXT_COORDENADAS 0x01  // Sub-código: posição do cursor (âncora do zoom)
+#define EXT_ROLAGEM   0x02    // Sub-código: deslocamento de rolagem da leitura da VRAM
+#define EXT_BASE      0x03    // Sub-código (v2): endereço base do fluxo nos bits 22:6
+#define EXT_VERSAO    0x04    // Sub-código (v2): consulta de versão, respondida com FLAG_V2_MASK
+#define EXT_REPETICAO 0x05    // Sub-código (v2): cada pixel do fluxo ocupa (bits 8:6) + 1 endereços
+#define REPETICAO_MAXIMA 8    // Maior repetição aceita; EXT_BASE volta a repetição para 1
+#define EXT_PAGINA_ESCRITA 0x06 // Sub-código (v2): página (bit 6) que recebe as escritas seguintes
+#define EXT_APRESENTAR 0x07   // Sub-código (v2): página (bit 6) exibida a partir do próximo retraço vertical;
+                              // com o bit 7, a rolagem volta a (0, 0) na mesma troca
+#define STREAM_OPCODE 0x01    // Opcode (v2): até 3 pixels nos bits 26:3, quantidade - 1 nos bits 28:27
+#define PIXELS_POR_PALAVRA 3  // Pixels carregados por instrução de fluxo
 #define FLAG_DONE_MASK 0x01   // Máscara para o bit 'DONE' (operação concluída)
 #define FLAG_ERROR_MASK 0x02  // Máscara para o bit 'ERROR' (erro de hardware)
+#define FLAG_ZOOM_Max_MASK 0x08 // Máscara lida por Flag_Max (zoom máximo)
+#define FLAG_ZOOM_Min_MASK 0x04 // Máscara lida por Flag_Min (zoom mínimo)
+// V2, PAGINAS, TROCA e ROLAGEM ficam nos bits 4 a 7: exigem PIO_FLAGS com 8 bits no Qsys.
+// Com o hps_0.h atual (PIO_FLAGS_DATA_WIDTH 4) o HPS lê esses bits em zero e a API fica
+// no v1, com uma página e sem rolagem; só o simulador (SIM_BITS_FLAGS=8) os exercita hoje.
+#define FLAG_V2_MASK  0x10    // Máscara para o bit de suporte ao protocolo v2
+#define FLAG_PAGINAS_MASK 0x20 // Resposta à consulta de versão: VRAM com duas páginas
+#define FLAG_TROCA_MASK 0x40  // Troca de página pedida e ainda não feita (espera o retraço)
+#define FLAG_ROLAGEM_MASK 0x80 // Resposta à consulta de versão: VGA aceita EXT_ROLAGEM
 #define TIMEOUT_COUNT 0x0 // Valor de timeout para a operação de hardware
 
 /**
@@ -35,6 +58,132 @@ int encerrarAPI();
  */
 int write_pixel(unsigned int address, unsigned char data);
 
+/**
+ * @brief Escreve 'n' pixels consecutivos a partir de 'address' (protocolo v2).
+ * @details Envia uma instrução de endereço base e depois instruções de fluxo com até
+ *          3 pixels cada; o hardware incrementa o endereço sozinho. Para no primeiro erro;
+ *          Pixels_Confirmados informa quantos pixels foram gravados antes dele.
+ * @return 0 em sucesso. -1 (INVALID_ADDR), -2 (TIMEOUT), -3 (HW_ERROR).
+ */
+int write_stream(unsigned int address, const unsigned char *src, int n);
+
+/**
+ * @brief Como write_stream, mas cada pixel de 'src' é repetido em 'fator' endereços seguidos.
+ * @details Envia a instrução de repetição logo após o endereço base; são gravados
+ *          n * fator pixels com o custo de n pixels no barramento (protocolo v2).
+ * @return 0 em sucesso. -1 (INVALID_ADDR ou fator fora de 1..8), -2 (TIMEOUT), -3 (HW_ERROR).
+ */
+int write_stream_rep(unsigned int address, const unsigned char *src, int n, int fator);
+
+/**
+ * @brief Consulta a versão do protocolo suportada pelo hardware.
+ * @details Hardware v2 responde à consulta ativando FLAG_V2_MASK; sem resposta dentro do
+ *          timeout assume-se v1. O resultado passa a ser usado por write_rect e fill_rect.
+ * @return 2 ou 1.
+ */
+int Detectar_Protocolo();
+
+/**
+ * @brief Força a versão do protocolo usada por write_rect e fill_rect (1 ou 2).
+ */
+void Definir_Protocolo(int versao);
+
+/**
+ * @brief Consulta quantas páginas de 320x240 a VRAM tem.
+ * @details Hardware com duas páginas ativa FLAG_PAGINAS_MASK junto com FLAG_V2_MASK na
+ *          resposta à consulta de versão.
+ * @return 2 ou 1.
+ */
+int Detectar_Paginas();
+
+/**
+ * @brief Consulta se a VGA aceita o deslocamento de rolagem (EXT_ROLAGEM).
+ * @details Hardware com rolagem ativa FLAG_ROLAGEM_MASK junto com FLAG_V2_MASK na
+ *          resposta à consulta de versão. Sem ela, Definir_Rolagem não deve ser usada.
+ * @return 1 ou 0.
+ */
+int Detectar_Rolagem();
+
+/**
+ * @brief Escolhe a página (0 ou 1) que recebe as escritas seguintes.
+ * @details Os endereços de write_pixel, write_stream etc. continuam de 0 a VRAM_MAX_ADDR - 1,
+ *          relativos à página escolhida. Espera a instrução ser aceita.
+ * @return 0 em sucesso. -2 (TIMEOUT), -3 (HW_ERROR).
+ */
+int Definir_Pagina_Escrita(int pagina);
+
+/**
+ * @brief Pede que a VGA passe a exibir a página (0 ou 1) e espera a troca.
+ * @details A troca é feita pelo hardware no próximo retraço vertical, sem cortar o quadro
+ *          em exibição; FLAG_TROCA_MASK fica ativa até lá (no máximo um quadro da VGA).
+ *          Com zerar_rolagem, a rolagem volta a (0, 0) no mesmo retraço, e a página que sai
+ *          da tela continua exibida com o deslocamento até a troca.
+ * @return 0 em sucesso. -2 (TIMEOUT), -3 (HW_ERROR).
+ */
+int Apresentar_Pagina(int pagina, int zerar_rolagem);
+
+/**
+ * @brief Como Apresentar_Pagina, mas retorna assim que a instrução é aceita, sem esperar o retraço.
+ * @details A página pedida pode continuar recebendo escritas, que aparecem a partir da troca;
+ *          a outra página só pode ser escrita depois de Esperar_Troca.
+ * @return 0 em sucesso. -2 (TIMEOUT), -3 (HW_ERROR).
+ */
+int Solicitar_Pagina(int pagina, int zerar_rolagem);
+
+/**
+ * @brief Espera a troca pedida por Solicitar_Pagina (FLAG_TROCA_MASK cai no retraço vertical).
+ * @return 0 depois da troca. -2 (TIMEOUT).
+ */
+int Esperar_Troca();
+
+/**
+ * @brief Copia um retângulo de pixels para a VRAM, linha a linha.
+ * @details O retângulo é recortado contra a área 320x240; as colunas e linhas descartadas
+ *          são puladas também na origem. Cada linha é escrita em endereços sequenciais,
+ *          pixel a pixel no protocolo v1 ou com write_stream no v2. Para no primeiro erro.
+ * @param dst_x Coluna de destino (pode ser negativa).
+ * @param dst_y Linha de destino (pode ser negativa).
+ * @param w Largura do retângulo em pixels.
+ * @param h Altura do retângulo em pixels.
+ * @param src Primeiro pixel da origem (canto superior esquerdo do retângulo).
+ * @param src_stride Distância em bytes entre linhas consecutivas da origem.
+ * @return 0 em sucesso ou o código de erro da primeira escrita que falhou.
+ */
+int write_rect(int dst_x, int dst_y, int w, int h, const unsigned char *src, int src_stride);
+
+/**
+ * @brief Preenche um retângulo da VRAM com um único valor.
+ * @details Mesmo recorte de write_rect contra a área 320x240. Para no primeiro erro.
+ * @return 0 em sucesso ou o código de erro da primeira escrita que falhou.
+ */
+int fill_rect(int x, int y, int w, int h, unsigned char value);
+
+/**
+ * @brief Pixels gravados pela última chamada de write_stream, write_stream_rep, write_rect
+ *        ou fill_rect antes de ela parar.
+ * @details Contados na ordem de escrita (linha a linha dentro do retângulo já recortado,
+ *          com a repetição incluída). Depois de um erro, o pixel seguinte é o primeiro da
+ *          instrução que falhou: um pixel no v1 ou uma palavra de fluxo no v2.
+ * @return Quantidade de pixels confirmados.
+ */
+int Pixels_Confirmados();
+
+/**
+ * @brief Envia a posição do cursor na tela 640x480, usada como âncora do zoom.
+ * @details Instrução estendida: x nos bits 15:6 e y nos bits 24:16.
+ * @return 0.
+ */
+int Enviar_Coordenadas(int x, int y);
+
+/**
+ * @brief Define a partir de qual coluna e linha a VGA lê a VRAM, com retorno circular.
+ * @details Instrução estendida: coluna (0..319) nos bits 14:6 e linha (0..239) nos bits 22:15.
+ *          Com (0, 0) a VRAM é exibida sem deslocamento. Só tem efeito no hardware
+ *          detectado por Detectar_Rolagem.
+ * @return 0.
+ */
+int Definir_Rolagem(int x, int y);
+
 /**
  * @brief Inicia o processamento de 'Vizinho Próximo'.
  * @details Envia a instrução 3 para o PIO.
@@ -1,4 +1,5 @@
 #define _XOPEN_SOURCE 500
+#define _DEFAULT_SOURCE   // st_mtim (instante de modificação em ns)
 #include <stdio.h>
 #include "header.h"
 #include <unistd.h>
@@ -10,11 +11,35 @@
 #include <unistd.h>
 #include <fcntl.h> 
 #include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <math.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 extern int iniciarBib();
 extern int encerrarBib();
 extern void Vizinho_Prox();
 extern int write_pixel(unsigned int address, unsigned char data);
+extern int write_rect(int dst_x, int dst_y, int w, int h, const unsigned char *src, int src_stride);
+extern int fill_rect(int x, int y, int w, int h, unsigned char value);
+extern int write_stream(unsigned int address, const unsigned char *src, int n);
+extern int write_stream_rep(unsigned int address, const unsigned char *src, int n, int fator);
+extern int Pixels_Confirmados();
+extern int Detectar_Protocolo();
+extern void Definir_Protocolo(int versao);
+extern int Detectar_Paginas();
+extern int Detectar_Rolagem();
+extern int Definir_Pagina_Escrita(int pagina);
+extern int Apresentar_Pagina(int pagina, int zerar_rolagem);
+extern int Solicitar_Pagina(int pagina, int zerar_rolagem);
+extern int Esperar_Troca();
 extern void Reset();
 extern void Replicacao();
 extern void Decimacao();
@@ -24,6 +49,7 @@ extern int Flag_Error();
 extern int Flag_Max();
 extern int Flag_Min();
 extern int Enviar_Coordenadas(int x, int y);
+extern int Definir_Rolagem(int x, int y);
 
 // Estrutura do cabeçalho BMP
 #pragma pack(push, 1)
@@ -68,145 +94,1960 @@ unsigned char* imagem_recorte = NULL;
 int regiao_x_min = 0, regiao_y_min = 0, regiao_x_max = 0, regiao_y_max = 0;
 int regiao_ativa = 0;
 
-// Função para carregar e enviar imagem BMP
-int enviar_imagem_bmp(const char *filename) {
+// Dimensões da imagem na VRAM
+#define LARGURA_IMAGEM 320
+#define ALTURA_IMAGEM 240
+#define TOTAL_PIXELS (LARGURA_IMAGEM * ALTURA_IMAGEM)
+
+// Maior imagem de entrada aceita pelos decodificadores
+#define DIMENSAO_MAXIMA 4096
+
+// Níveis da pirâmide gerada no pré-processamento: 320x240, 160x120, 80x60, 40x30
+#define NIVEIS_PIRAMIDE 4
+
+// Imagem de entrada decodificada, ainda no formato de pixel do arquivo
+typedef struct {
+    int largura;
+    int altura;
+    int bits_por_pixel;
+    unsigned char *dados;
+} ImagemDecodificada;
+
+// Quadro pré-processado guardado no armazenamento em memória
+typedef struct {
+    char nome[256];
+    unsigned char *niveis[NIVEIS_PIRAMIDE];
+} QuadroArmazenado;
+
+// Armazenamento de quadros gerado pelo pré-processamento em lote
+typedef struct {
+    QuadroArmazenado *quadros;
+    int total;
+} ArmazenamentoQuadros;
+
+ArmazenamentoQuadros armazenamento = {NULL, 0};
+
+// Retorna o tempo monotônico atual em milissegundos
+double tempo_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Largura e altura de um nível da pirâmide
+int largura_nivel(int nivel) { return LARGURA_IMAGEM >> nivel; }
+int altura_nivel(int nivel) { return ALTURA_IMAGEM >> nivel; }
+
+// Formatos de entrada reconhecidos pelos carregadores
+typedef enum {
+    FORMATO_BMP,
+    FORMATO_PGM,
+    FORMATO_RAW
+} FormatoImagem;
+
+static const char *nomes_formatos[] = { "BMP", "PGM (P5)", "RAW 8 bits" };
+
+// Descrição do arquivo obtida do cabeçalho, usada para ler as linhas sob demanda
+typedef struct {
+    FormatoImagem formato;
+    int largura;
+    int altura;
+    int bytes_por_pixel;    // 1 (cinza) ou 3 (BGR)
+    int valor_maximo;       // maxval do PGM; 255 nos demais formatos
+    int de_baixo_para_cima; // BMP com altura positiva
+    long offset_dados;
+    long passo_linha;       // bytes por linha no arquivo, incluindo padding
+} InfoImagem;
+
+// Lê o cabeçalho BMP (a assinatura "BM" já foi verificada)
+int ler_cabecalho_bmp(FILE *file, InfoImagem *info) {
+    BMPHeader header;
+    BMPInfoHeader bmp;
+
+    rewind(file);
+    if (fread(&header, sizeof(BMPHeader), 1, file) != 1 ||
+        fread(&bmp, sizeof(BMPInfoHeader), 1, file) != 1) {
+        return -1;
+    }
+
+    if (bmp.bits_per_pixel != 8 && bmp.bits_per_pixel != 24) {
+        printf("ERRO: Formato de pixel não suportado (%d bits)\n", bmp.bits_per_pixel);
+        return -1;
+    }
+
+    // Só BI_RGB (sem compressão): RLE e bitfields não têm o passo de linha fixo lido abaixo
+    if (bmp.compression != 0) {
+        printf("ERRO: BMP comprimido não suportado (compression = %u)\n", (unsigned)bmp.compression);
+        return -1;
+    }
+
+    // Os pixels não podem começar dentro dos dois cabeçalhos
+    if (header.offset < sizeof(BMPHeader) + sizeof(BMPInfoHeader)) {
+        printf("ERRO: Offset dos pixels (%u) dentro do cabeçalho\n", (unsigned)header.offset);
+        return -1;
+    }
+
+    // Rejeita dimensões absurdas antes de calcular o passo de linha
+    if (bmp.width <= 0 || bmp.width > DIMENSAO_MAXIMA ||
+        bmp.height == 0 || bmp.height < -DIMENSAO_MAXIMA || bmp.height > DIMENSAO_MAXIMA) {
+        return -1;
+    }
+
+    info->largura = bmp.width;
+    info->altura = bmp.height < 0 ? -bmp.height : bmp.height;
+    info->de_baixo_para_cima = bmp.height > 0;
+    info->bytes_por_pixel = bmp.bits_per_pixel / 8;
+    info->valor_maximo = 255;
+    info->offset_dados = header.offset;
+
+    long row_size = (long)info->largura * info->bytes_por_pixel;
+    info->passo_linha = row_size + (4 - (row_size % 4)) % 4;
+    return 0;
+}
+
+// Lê um número do cabeçalho PGM, pulando espaços e comentários
+int ler_numero_pgm(FILE *file) {
+    int c, valor = 0, digitos = 0;
+
+    while ((c = fgetc(file)) != EOF) {
+        if (c == '#') {
+            while ((c = fgetc(file)) != EOF && c != '\n');
+        } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            break;
+        }
+    }
+
+    while (c >= '0' && c <= '9' && digitos < 6) {
+        valor = valor * 10 + (c - '0');
+        digitos++;
+        c = fgetc(file);
+    }
+
+    // Exatamente um espaço em branco separa o cabeçalho dos dados
+    if (digitos == 0 || (c != ' ' && c != '\t' && c != '\r' && c != '\n')) {
+        return -1;
+    }
+    return valor;
+}
+
+// Lê o cabeçalho PGM binário (a assinatura "P5" já foi verificada)
+int ler_cabecalho_pgm(FILE *file, InfoImagem *info) {
+    fseek(file, 2, SEEK_SET);
+    info->largura = ler_numero_pgm(file);
+    info->altura = ler_numero_pgm(file);
+    info->valor_maximo = ler_numero_pgm(file);
+
+    if (info->valor_maximo < 1 || info->valor_maximo > 255) {
+        printf("ERRO: PGM com maxval %d não suportado (apenas 8 bits)\n", info->valor_maximo);
+        return -1;
+    }
+
+    info->bytes_por_pixel = 1;
+    info->de_baixo_para_cima = 0;
+    info->offset_dados = ftell(file);
+    info->passo_linha = info->largura;
+    return 0;
+}
+
+// Verifica se o nome termina com a extensão informada (sem diferenciar maiúsculas)
+int tem_extensao(const char *nome, const char *extensao) {
+    size_t n = strlen(nome);
+    size_t e = strlen(extensao);
+    return n > e && strcasecmp(nome + n - e, extensao) == 0;
+}
+
+// Identifica o formato pelos bytes mágicos e valida o cabeçalho contra o tamanho do arquivo
+int ler_cabecalho_imagem(FILE *file, const char *filename, InfoImagem *info) {
+    unsigned char magico[2] = {0, 0};
+    long tamanho;
+
+    fseek(file, 0, SEEK_END);
+    tamanho = ftell(file);
+    rewind(file);
+
+    if (fread(magico, 1, 2, file) != 2) {
+        printf("ERRO: '%s' está vazio ou truncado!\n", filename);
+        return -1;
+    }
+
+    // RAW não tem cabeçalho: um quadro de 76.800 bytes cujos primeiros pixels formem
+    // "BM" ou "P5" só é lido como RAW se o arquivo tiver a extensão .raw
+    int raw = tamanho == TOTAL_PIXELS &&
+              (tem_extensao(filename, ".raw") ||
+               !((magico[0] == 'B' && magico[1] == 'M') || (magico[0] == 'P' && magico[1] == '5')));
+
+    int status;
+    if (raw) {
+        info->formato = FORMATO_RAW;
+        info->largura = LARGURA_IMAGEM;
+        info->altura = ALTURA_IMAGEM;
+        info->bytes_por_pixel = 1;
+        info->valor_maximo = 255;
+        info->de_baixo_para_cima = 0;
+        info->offset_dados = 0;
+        info->passo_linha = LARGURA_IMAGEM;
+        status = 0;
+    } else if (magico[0] == 'B' && magico[1] == 'M') {
+        info->formato = FORMATO_BMP;
+        status = ler_cabecalho_bmp(file, info);
+    } else if (magico[0] == 'P' && magico[1] == '5') {
+        info->formato = FORMATO_PGM;
+        status = ler_cabecalho_pgm(file, info);
+    } else {
+        printf("ERRO: Formato de '%s' não reconhecido (esperado BMP, PGM P5 ou RAW 320x240)\n", filename);
+        return -1;
+    }
+
+    if (status != 0) {
+        printf("ERRO: Cabeçalho %s inválido em '%s'!\n", nomes_formatos[info->formato], filename);
+        return -1;
+    }
+
+    if (info->largura <= 0 || info->altura <= 0 ||
+        info->largura > DIMENSAO_MAXIMA || info->altura > DIMENSAO_MAXIMA) {
+        printf("ERRO: Dimensões inválidas (%dx%d)\n", info->largura, info->altura);
+        return -1;
+    }
+
+    // A última linha precisa caber inteira no arquivo. long tem 32 bits no ARM: o offset
+    // é comparado antes da soma, e a soma é feita em 64 bits
+    if (info->offset_dados < 0 || info->offset_dados > tamanho) {
+        printf("ERRO: Arquivo '%s' truncado!\n", filename);
+        return -1;
+    }
+    int64_t fim_dados = (int64_t)info->offset_dados + (int64_t)info->passo_linha * (info->altura - 1) +
+                        (int64_t)info->largura * info->bytes_por_pixel;
+    if (fim_dados > tamanho) {
+        printf("ERRO: Arquivo '%s' truncado!\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Lê 'n' pixels a partir da coluna x0 da linha y (de cima para baixo) para 'destino'
+int ler_linha_imagem(FILE *file, const InfoImagem *info, int y, int x0, int n,
+                     unsigned char *destino) {
+    int linha = info->de_baixo_para_cima ? info->altura - 1 - y : y;
+    long posicao = info->offset_dados + linha * info->passo_linha +
+                   (long)x0 * info->bytes_por_pixel;
+    size_t bytes = (size_t)n * info->bytes_por_pixel;
+
+    if (fseek(file, posicao, SEEK_SET) != 0 || fread(destino, 1, bytes, file) != bytes) {
+        return -1;
+    }
+
+    // PGM com maxval menor que 255 é reescalado para a faixa completa
+    if (info->valor_maximo != 255) {
+        for (int i = 0; i < n; i++) {
+            int v = destino[i] > info->valor_maximo ? info->valor_maximo : destino[i];
+            destino[i] = (v * 255 + info->valor_maximo / 2) / info->valor_maximo;
+        }
+    }
+
+    return 0;
+}
+
+// Abre o arquivo e lê o cabeçalho de qualquer formato suportado
+FILE* abrir_imagem(const char *filename, InfoImagem *info, int verboso) {
     FILE *file = fopen(filename, "rb");
     if (!file) {
         printf("ERRO: Não foi possível abrir o arquivo '%s'\n", filename);
+        return NULL;
+    }
+
+    if (ler_cabecalho_imagem(file, filename, info) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    if (verboso) {
+        printf("Formato: %s\n", nomes_formatos[info->formato]);
+        printf("Dimensões: %dx%d pixels\n", info->largura, info->altura);
+        printf("Bits por pixel: %d\n", info->bytes_por_pixel * 8);
+        if (info->largura != LARGURA_IMAGEM || info->altura != ALTURA_IMAGEM) {
+            printf("AVISO: Imagem com dimensões diferentes de 320x240!\n");
+        }
+    }
+
+    return file;
+}
+
+// Estágio 1: lê o arquivo inteiro para memória, com as linhas já de cima para baixo
+int decodificar_imagem(const char *filename, ImagemDecodificada *img, int verboso) {
+    InfoImagem info;
+    FILE *file = abrir_imagem(filename, &info, verboso);
+    if (!file) return -1;
+
+    size_t row_size = (size_t)info.largura * info.bytes_por_pixel;
+
+    img->largura = info.largura;
+    img->altura = info.altura;
+    img->bits_por_pixel = info.bytes_por_pixel * 8;
+    img->dados = (unsigned char*)malloc(row_size * info.altura);
+    if (!img->dados) {
+        printf("ERRO: Falha ao alocar memória!\n");
+        fclose(file);
         return -1;
     }
 
-    BMPHeader header;
-    BMPInfoHeader info;
-    
-    fread(&header, sizeof(BMPHeader), 1, file);
-    fread(&info, sizeof(BMPInfoHeader), 1, file);
+    for (int y = 0; y < info.altura; y++) {
+        if (ler_linha_imagem(file, &info, y, 0, info.largura, img->dados + y * row_size) != 0) {
+            printf("ERRO: Arquivo '%s' truncado!\n", filename);
+            free(img->dados);
+            img->dados = NULL;
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// Estágio 2: converte a imagem BGR de 24 bits para 8 bits em tons de cinza
+void converter_cinza(const ImagemDecodificada *img, unsigned char *cinza) {
+    int total = img->largura * img->altura;
+    const unsigned char *p = img->dados;
+    for (int i = 0; i < total; i++, p += 3) {
+        cinza[i] = (p[0] + p[1] + p[2]) / 3;
+    }
+}
+
+// Estágio 3: recorta (ou completa com preto) a imagem centralizada em 320x240
+void recortar_centralizado(const unsigned char *cinza, int largura, int altura,
+                           unsigned char *quadro) {
+    int larg_copia = largura < LARGURA_IMAGEM ? largura : LARGURA_IMAGEM;
+    int alt_copia = altura < ALTURA_IMAGEM ? altura : ALTURA_IMAGEM;
+    int orig_x = (largura - larg_copia) / 2;
+    int orig_y = (altura - alt_copia) / 2;
+    int dest_x = (LARGURA_IMAGEM - larg_copia) / 2;
+    int dest_y = (ALTURA_IMAGEM - alt_copia) / 2;
+
+    if (larg_copia != LARGURA_IMAGEM || alt_copia != ALTURA_IMAGEM) {
+        memset(quadro, 0, TOTAL_PIXELS);
+    }
+
+    for (int y = 0; y < alt_copia; y++) {
+        memcpy(quadro + (dest_y + y) * LARGURA_IMAGEM + dest_x,
+               cinza + (size_t)(orig_y + y) * largura + orig_x,
+               larg_copia);
+    }
+}
+
+// Média com arredondamento de cada bloco 2x2 formado por duas linhas consecutivas
+void reduzir_linhas_2x2(const unsigned char *l0, const unsigned char *l1,
+                        unsigned char *dest, int larg) {
+    int x = 0;
+#ifdef __ARM_NEON
+    // 16 pixels de saída por iteração: soma par a par em 16 bits e (s + 2) >> 2
+    for (; x + 16 <= larg; x += 16) {
+        uint8x16x2_t a = vld2q_u8(l0 + 2 * x);
+        uint8x16x2_t b = vld2q_u8(l1 + 2 * x);
+        uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a.val[0]), vget_low_u8(a.val[1])),
+                                  vaddl_u8(vget_low_u8(b.val[0]), vget_low_u8(b.val[1])));
+        uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a.val[0]), vget_high_u8(a.val[1])),
+                                  vaddl_u8(vget_high_u8(b.val[0]), vget_high_u8(b.val[1])));
+        vst1q_u8(dest + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+#endif
+    for (; x < larg; x++) {
+        dest[x] = (l0[2 * x] + l0[2 * x + 1] + l1[2 * x] + l1[2 * x + 1] + 2) >> 2;
+    }
+}
+
+// Estágio 4: gera os níveis da pirâmide por média de blocos 2x2
+void gerar_piramide(unsigned char *niveis[NIVEIS_PIRAMIDE]) {
+    for (int n = 1; n < NIVEIS_PIRAMIDE; n++) {
+        const unsigned char *orig = niveis[n - 1];
+        unsigned char *dest = niveis[n];
+        int larg_orig = largura_nivel(n - 1);
+        int larg = largura_nivel(n);
+        int alt = altura_nivel(n);
+
+        for (int y = 0; y < alt; y++) {
+            const unsigned char *l0 = orig + (2 * y) * larg_orig;
+            reduzir_linhas_2x2(l0, l0 + larg_orig, dest + y * larg, larg);
+        }
+    }
+}
+
+// Carrega qualquer formato suportado direto para um quadro 320x240, linha a linha.
+// Só a janela centralizada é lida; linhas em tons de cinza vão direto para o quadro.
+int carregar_quadro(const char *filename, unsigned char *quadro, int verboso) {
+    InfoImagem info;
+    FILE *file = abrir_imagem(filename, &info, verboso);
+    if (!file) return -1;
+
+    int larg_copia = info.largura < LARGURA_IMAGEM ? info.largura : LARGURA_IMAGEM;
+    int alt_copia = info.altura < ALTURA_IMAGEM ? info.altura : ALTURA_IMAGEM;
+    int orig_x = (info.largura - larg_copia) / 2;
+    int orig_y = (info.altura - alt_copia) / 2;
+    int dest_x = (LARGURA_IMAGEM - larg_copia) / 2;
+    int dest_y = (ALTURA_IMAGEM - alt_copia) / 2;
+    unsigned char linha[LARGURA_IMAGEM * 3];
+
+    if (larg_copia != LARGURA_IMAGEM || alt_copia != ALTURA_IMAGEM) {
+        memset(quadro, 0, TOTAL_PIXELS);
+    }
+
+    for (int y = 0; y < alt_copia; y++) {
+        unsigned char *destino = quadro + (dest_y + y) * LARGURA_IMAGEM + dest_x;
+        unsigned char *leitura = info.bytes_por_pixel == 1 ? destino : linha;
+
+        if (ler_linha_imagem(file, &info, orig_y + y, orig_x, larg_copia, leitura) != 0) {
+            printf("ERRO: Arquivo '%s' truncado!\n", filename);
+            fclose(file);
+            return -1;
+        }
+
+        if (info.bytes_por_pixel == 3) {
+            for (int x = 0; x < larg_copia; x++) {
+                destino[x] = (linha[3 * x] + linha[3 * x + 1] + linha[3 * x + 2]) / 3;
+            }
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// ================= TRANSFERÊNCIA COM VERIFICAÇÃO =================
+
+// Protocolo da VRAM detectado na inicialização
+int protocolo_vram = 1;
+
+// Páginas da VRAM (2 no hardware com troca de página). Com duas, cada quadro é escrito
+// na página oculta e só aparece inteiro, na troca feita pela VGA no retraço vertical.
+int paginas_vram = 1;
+int pagina_exibida = 0, pagina_escrita = 0;
+double ultima_troca_ms = 0.0;   // espera pelo retraço na última troca
+int rolagem_na_troca = 0;       // Definir_Rolagem(0, 0) adiada para a próxima troca
+int troca_pendente = 0;         // troca pedida sem esperar o retraço (Solicitar_Pagina)
+int rolagem_troca_pendente = 0; // a troca pendente também zera a rolagem
+
+// O que cada endereço de cada página deveria conter; as retentativas reenviam daqui.
+// vram_sombra aponta para a sombra da página de escrita.
+unsigned char sombras[2][TOTAL_PIXELS];
+unsigned char *vram_sombra = sombras[0];
+
+// A sombra só vale como cópia da VRAM depois de um quadro inteiro sem pixels pendentes.
+// sombra_confiavel é a da página de escrita; a da outra fica guardada em sombras_confiaveis.
+int sombra_confiavel = 0;
+int sombras_confiaveis[2] = {0, 0};
+
+#define MAX_FAIXAS_FALHA 256
+#define MAX_RETENTATIVAS 4
+#define ESPERA_RETENTATIVA_US 500   // dobra a cada rodada
+
+// Endereços [inicio, fim) cuja escrita falhou
+typedef struct {
+    unsigned int inicio, fim;
+} FaixaFalha;
+
+// Falhas pendentes e contadores do quadro em envio
+typedef struct {
+    FaixaFalha faixas[MAX_FAIXAS_FALHA];
+    int num_faixas;
+    long pixels;            // pixels enviados no quadro
+    long pixels_falhos;     // pixels que falharam na primeira tentativa
+    long reenviados;        // pixels reenviados nas retentativas
+    int timeouts, erros_hw; // instruções que falharam, por tipo
+    int rodadas, resets;
+    int erro_hw_rodada;     // houve HW_ERROR desde a última rodada
+} RegistroTransferencia;
+
+RegistroTransferencia transferencia;
+
+// No modo zoom o Reset das retentativas desfaria o zoom do hardware: fica suspenso
+int zoom_ativo = 0;
+
+// Passa as escritas para outra página, trocando também a sombra em uso
+void selecionar_pagina_escrita(int pagina) {
+    if (pagina == pagina_escrita) return;
+
+    // Sem confirmação do hardware, o quadro segue na página atual
+    if (Definir_Pagina_Escrita(pagina) != 0) {
+        printf("⚠️  Falha ao selecionar a página %d da VRAM\n", pagina);
+        return;
+    }
+    sombras_confiaveis[pagina_escrita] = sombra_confiavel;
+    pagina_escrita = pagina;
+    vram_sombra = sombras[pagina];
+    sombra_confiavel = sombras_confiaveis[pagina];
+}
+
+// Troca sem confirmação: sem saber qual página está na tela, o próximo quadro volta a
+// ser escrito inteiro
+void registrar_troca(int status, int zerar_rolagem) {
+    if (status == 0) return;
+
+    printf("⚠️  Troca de página sem confirmação (%d)\n", status);
+    sombras_confiaveis[0] = sombras_confiaveis[1] = 0;
+    sombra_confiavel = 0;
+    if (zerar_rolagem) {
+        Definir_Rolagem(0, 0);
+    }
+}
+
+// Espera a troca pedida sem espera; antes dela a outra página ainda está na tela
+void esperar_troca_pendente() {
+    if (!troca_pendente) return;
+
+    double inicio = tempo_ms();
+    int status = Esperar_Troca();
+    ultima_troca_ms = tempo_ms() - inicio;
+    troca_pendente = 0;
+    registrar_troca(status, rolagem_troca_pendente);
+}
+
+// Descarta as falhas pendentes (a sombra da página deixa de refletir a VRAM) e,
+// com duas páginas, passa a escrever na oculta
+void preparar_pagina_oculta() {
+    if (transferencia.num_faixas > 0) {
+        sombra_confiavel = 0;
+        transferencia.num_faixas = 0;
+    }
+    if (paginas_vram == 2) {
+        esperar_troca_pendente();
+        selecionar_pagina_escrita(1 - pagina_exibida);
+    }
+}
+
+// Exibe a página recém-escrita. As escritas seguem na mesma página, agora visível: a
+// rolagem atualiza só as bordas do quadro em exibição. Com 'esperar', só retorna depois
+// da troca; sem ele a troca fica pendente e as escritas seguintes já vão para a página
+// nova (aparecem a partir do retraço), sem parar o envio à espera da VGA.
+void apresentar_pagina_oculta(int esperar) {
+    esperar_troca_pendente();
+    if (paginas_vram != 2 || pagina_escrita == pagina_exibida) {
+        // Quadro escrito na página em exibição: a rolagem adiada não espera mais
+        if (rolagem_na_troca) {
+            Definir_Rolagem(0, 0);
+            rolagem_na_troca = 0;
+        }
+        return;
+    }
+
+    if (esperar) {
+        double inicio = tempo_ms();
+        int status = Apresentar_Pagina(pagina_escrita, rolagem_na_troca);
+        ultima_troca_ms = tempo_ms() - inicio;
+        registrar_troca(status, rolagem_na_troca);
+    } else {
+        int status = Solicitar_Pagina(pagina_escrita, rolagem_na_troca);
+        if (status == 0) {
+            troca_pendente = 1;
+            rolagem_troca_pendente = rolagem_na_troca;
+        } else {
+            registrar_troca(status, rolagem_na_troca);
+        }
+    }
+    rolagem_na_troca = 0;
+    pagina_exibida = pagina_escrita;
+}
+
+// Zera os contadores no início de um quadro, que vai para a página oculta
+void iniciar_quadro_transferencia() {
+    preparar_pagina_oculta();
+    memset(&transferencia, 0, sizeof(transferencia));
+}
+
+// Junta [inicio, fim) às faixas pendentes, mantendo-as ordenadas e sem sobreposição.
+// Com a tabela cheia, une as duas faixas mais próximas (reenvia alguns pixels bons).
+void registrar_falha(unsigned int inicio, unsigned int fim, int status) {
+    RegistroTransferencia *t = &transferencia;
+    int i = 0;
+
+    if (status == -2) t->timeouts++;
+    if (status == -3) {
+        t->erros_hw++;
+        t->erro_hw_rodada = 1;
+    }
+
+    while (i < t->num_faixas && t->faixas[i].fim < inicio) i++;
+
+    if (i < t->num_faixas && t->faixas[i].inicio <= fim) {
+        // Sobrepõe ou encosta na faixa i: estende e absorve as seguintes
+        if (inicio < t->faixas[i].inicio) t->faixas[i].inicio = inicio;
+        if (fim > t->faixas[i].fim) t->faixas[i].fim = fim;
+        int j = i + 1;
+        while (j < t->num_faixas && t->faixas[j].inicio <= t->faixas[i].fim) {
+            if (t->faixas[j].fim > t->faixas[i].fim) t->faixas[i].fim = t->faixas[j].fim;
+            j++;
+        }
+        memmove(&t->faixas[i + 1], &t->faixas[j], (t->num_faixas - j) * sizeof(FaixaFalha));
+        t->num_faixas -= j - (i + 1);
+        return;
+    }
+
+    if (t->num_faixas == MAX_FAIXAS_FALHA) {
+        int menor = 0;
+        for (int k = 1; k < t->num_faixas - 1; k++) {
+            if (t->faixas[k + 1].inicio - t->faixas[k].fim <
+                t->faixas[menor + 1].inicio - t->faixas[menor].fim) {
+                menor = k;
+            }
+        }
+        t->faixas[menor].fim = t->faixas[menor + 1].fim;
+        memmove(&t->faixas[menor + 1], &t->faixas[menor + 2],
+                (t->num_faixas - menor - 2) * sizeof(FaixaFalha));
+        t->num_faixas--;
+        registrar_falha(inicio, fim, 0);
+        return;
+    }
+
+    memmove(&t->faixas[i + 1], &t->faixas[i], (t->num_faixas - i) * sizeof(FaixaFalha));
+    t->faixas[i].inicio = inicio;
+    t->faixas[i].fim = fim;
+    t->num_faixas++;
+}
+
+// Escreve o retângulo (x, y, w, h), já recortado, com write_rect a partir da sombra ou,
+// com 'preencher', com fill_rect de 'valor'. Numa falha só a instrução que falhou (um
+// pixel no v1, uma palavra de fluxo no v2) vai para a fila, e a escrita continua logo
+// depois dela. Retorna o número de pixels que falharam.
+long escrever_rect_verificado(int x, int y, int w, int h, int preencher, unsigned char valor) {
+    int unidade = protocolo_vram == 2 ? PIXELS_POR_PALAVRA : 1;
+    long falhos = 0;
+    int j = 0, k = 0;   // linha e coluna, relativas ao retângulo, onde a escrita continua
+
+    while (j < h) {
+        // Retomada no meio de uma linha: termina a linha antes de voltar ao retângulo
+        int rx = x + k, ry = y + j;
+        int rw = w - k, rh = k > 0 ? 1 : h - j;
+        int status = preencher
+            ? fill_rect(rx, ry, rw, rh, valor)
+            : write_rect(rx, ry, rw, rh, vram_sombra + ry * LARGURA_IMAGEM + rx, LARGURA_IMAGEM);
+        if (status == 0) {
+            j += rh;
+            k = 0;
+            continue;
+        }
+
+        int feitos = Pixels_Confirmados();
+        j += feitos / rw;
+        int coluna = k + feitos % rw;
+        int n = w - coluna < unidade ? w - coluna : unidade;
+        unsigned int inicio = (y + j) * LARGURA_IMAGEM + x + coluna;
+
+        registrar_falha(inicio, inicio + n, status);
+        falhos += n;
+        k = coluna + n;
+        if (k == w) {
+            j++;
+            k = 0;
+        }
+    }
+    return falhos;
+}
+
+// Escreve os endereços [inicio, fim) a partir da sombra, com as linhas inteiras do meio
+// num único retângulo. Retorna o número de pixels que falharam.
+long escrever_da_sombra(unsigned int inicio, unsigned int fim) {
+    long falhos = 0;
+
+    while (inicio < fim) {
+        int x = inicio % LARGURA_IMAGEM;
+        int y = inicio / LARGURA_IMAGEM;
+        int w = LARGURA_IMAGEM - x;
+        int h = 1;
+        if (x == 0 && fim - inicio >= LARGURA_IMAGEM) {
+            h = (fim - inicio) / LARGURA_IMAGEM;
+        } else if (w > (int)(fim - inicio)) {
+            w = fim - inicio;
+        }
+        falhos += escrever_rect_verificado(x, y, w, h, 0, 0);
+        inicio += (unsigned int)w * h;
+    }
+    return falhos;
+}
+
+// Recorta o retângulo contra a VRAM; retorna 0 se nada sobrou
+int recortar_vram(int *x, int *y, int *w, int *h) {
+    if (*x < 0) { *w += *x; *x = 0; }
+    if (*y < 0) { *h += *y; *y = 0; }
+    if (*w > LARGURA_IMAGEM - *x) *w = LARGURA_IMAGEM - *x;
+    if (*h > ALTURA_IMAGEM - *y) *h = ALTURA_IMAGEM - *y;
+    return *w > 0 && *h > 0;
+}
+
+// Escreve a sombra já atualizada do retângulo (x, y, w, h)
+void escrever_rect_sombra(int x, int y, int w, int h) {
+    transferencia.pixels_falhos += escrever_rect_verificado(x, y, w, h, 0, 0);
+    transferencia.pixels += (long)w * h;
+}
+
+// write_rect com registro das falhas
+void transferir_rect(int x, int y, int w, int h, const unsigned char *src, int stride) {
+    int x0 = x, y0 = y;
+    if (!recortar_vram(&x, &y, &w, &h)) return;
+    src += (y - y0) * stride + (x - x0);
+
+    for (int j = 0; j < h; j++) {
+        memcpy(vram_sombra + (y + j) * LARGURA_IMAGEM + x, src + j * stride, w);
+    }
+    escrever_rect_sombra(x, y, w, h);
+}
+
+// fill_rect com registro das falhas
+void preencher_rect(int x, int y, int w, int h, unsigned char valor) {
+    if (!recortar_vram(&x, &y, &w, &h)) return;
+
+    for (int j = 0; j < h; j++) {
+        memset(vram_sombra + (y + j) * LARGURA_IMAGEM + x, valor, w);
+    }
+    transferencia.pixels_falhos += escrever_rect_verificado(x, y, w, h, 1, valor);
+    transferencia.pixels += (long)w * h;
+}
+
+// write_stream_rep com registro das falhas: só a palavra que falhou (3 amostras já
+// repetidas) volta para a fila, reenviada da sombra sem repetição; o fluxo continua depois dela
+void transferir_repetido(unsigned int inicio, const unsigned char *amostras, int n, int fator) {
+    for (int i = 0; i < n; i++) {
+        memset(vram_sombra + inicio + i * fator, amostras[i], fator);
+    }
+    transferencia.pixels += (long)n * fator;
+
+    int feitas = 0;
+    while (feitas < n) {
+        unsigned int base = inicio + feitas * fator;
+        int status = write_stream_rep(base, amostras + feitas, n - feitas, fator);
+        if (status == 0) break;
+
+        int ok = Pixels_Confirmados() / fator;
+        int perdidas = n - feitas - ok < PIXELS_POR_PALAVRA ? n - feitas - ok : PIXELS_POR_PALAVRA;
+        unsigned int falha = base + ok * fator;
+        registrar_falha(falha, falha + perdidas * fator, status);
+        transferencia.pixels_falhos += perdidas * fator;
+        feitas += ok + perdidas;
+    }
+}
+
+// Depois de um HW_ERROR, reescreve o primeiro pixel pendente: se ele também volta com
+// HW_ERROR, o erro ficou travado no hardware e só o Reset o libera
+int erro_hw_travado() {
+    unsigned int endereco = transferencia.faixas[0].inicio;
+    return write_pixel(endereco, vram_sombra[endereco]) == -3;
+}
+
+// Reenvia as faixas pendentes com espera crescente entre as rodadas. Se houve HW_ERROR
+// e ele continua travado, envia Reset antes da rodada (só se 'pode_resetar' e fora do
+// modo zoom: o Reset também desfaz o zoom); erros passageiros só são reenviados.
+// Retorna os pixels ainda pendentes.
+long reenviar_falhas(int pode_resetar) {
+    RegistroTransferencia *t = &transferencia;
+    FaixaFalha pendentes[MAX_FAIXAS_FALHA];
+
+    for (int rodada = 0; rodada < MAX_RETENTATIVAS && t->num_faixas > 0; rodada++) {
+        int erro_hw = t->erro_hw_rodada;
+        t->erro_hw_rodada = 0;
+
+        usleep(ESPERA_RETENTATIVA_US << rodada);
+        if (erro_hw && pode_resetar && !zoom_ativo && erro_hw_travado()) {
+            Reset();
+            t->resets++;
+            while (Flag_Done() == 0) {
+                usleep(1000);
+            }
+        }
+
+        int num = t->num_faixas;
+        memcpy(pendentes, t->faixas, num * sizeof(FaixaFalha));
+        t->num_faixas = 0;
+        t->rodadas++;
+
+        for (int i = 0; i < num; i++) {
+            t->reenviados += pendentes[i].fim - pendentes[i].inicio;
+            escrever_da_sombra(pendentes[i].inicio, pendentes[i].fim);
+        }
+    }
+
+    long restantes = 0;
+    for (int i = 0; i < t->num_faixas; i++) {
+        restantes += t->faixas[i].fim - t->faixas[i].inicio;
+    }
+    if (restantes > 0) {
+        sombra_confiavel = 0;
+    }
+    return restantes;
+}
+
+// Reenvia as falhas do quadro, exibe a página escrita e mostra o resumo de integridade
+void concluir_quadro_transferencia(const char *nome) {
+    RegistroTransferencia *t = &transferencia;
+    long restantes = reenviar_falhas(1);
+
+    // Quadro inteiro escrito e confirmado
+    if (restantes == 0) {
+        sombra_confiavel = 1;
+    }
+    apresentar_pagina_oculta(1);
+
+    if (paginas_vram == 2) {
+        printf("📄 %s exibido na página %d (troca em %.1f ms)\n", nome, pagina_exibida, ultima_troca_ms);
+    }
+
+    if (t->pixels_falhos == 0) {
+        printf("🧾 %s: %ld pixels escritos, nenhuma falha\n", nome, t->pixels);
+        return;
+    }
+
+    printf("🧾 %s: %ld pixels escritos, %ld falharam (%d timeouts, %d erros de hardware)\n",
+           nome, t->pixels, t->pixels_falhos, t->timeouts, t->erros_hw);
+    printf("   %ld reenviados em %d rodada(s), %d reset(s)", t->reenviados, t->rodadas, t->resets);
+    if (restantes > 0) {
+        printf(" | ⚠️  %ld pixels não confirmados em %d faixa(s)\n", restantes, t->num_faixas);
+    } else {
+        printf(" | ✅ quadro íntegro\n");
+    }
+}
+
+// ================= MAPEAMENTO DE TONS =================
+
+// Curvas de tom aplicadas no envio para a VRAM
+typedef enum {
+    TOM_NENHUM,
+    TOM_CONTRASTE,    // auto-níveis: estica a faixa útil do histograma para 0..255
+    TOM_GAMA,
+    TOM_EQUALIZACAO
+} ModoTom;
+
+static const char *nomes_tons[] = { "Nenhum", "Contraste automático", "Gama", "Equalização" };
+
+// Fração de pixels ignorada em cada ponta do histograma no contraste automático
+#define CONTRASTE_CORTE 0.005
+
+// Curva escolhida para as próximas imagens
+ModoTom modo_tom = TOM_NENHUM;
+double gama_tom = 1.0;
+
+// LUT calculada para a imagem em imagem_backup; o backup continua com os pixels originais
+unsigned char lut_tom[256];
+int lut_tom_ativa = 0;
+
+// Histograma com quatro tabelas intercaladas, para que pixels vizinhos iguais
+// não esperem o incremento anterior na mesma posição da memória
+void calcular_histograma(const unsigned char *pixels, int total, unsigned int hist[256]) {
+    unsigned int parcial[4][256];
+    int i = 0;
+
+    memset(parcial, 0, sizeof(parcial));
+    for (; i + 4 <= total; i += 4) {
+        parcial[0][pixels[i]]++;
+        parcial[1][pixels[i + 1]]++;
+        parcial[2][pixels[i + 2]]++;
+        parcial[3][pixels[i + 3]]++;
+    }
+    for (; i < total; i++) {
+        parcial[0][pixels[i]]++;
+    }
+
+    for (int v = 0; v < 256; v++) {
+        hist[v] = parcial[0][v] + parcial[1][v] + parcial[2][v] + parcial[3][v];
+    }
+}
+
+// Monta a LUT da curva escolhida a partir do histograma
+void construir_lut(ModoTom modo, double gama, const unsigned int hist[256], int total,
+                   unsigned char lut[256]) {
+    for (int v = 0; v < 256; v++) lut[v] = v;
+
+    if (modo == TOM_CONTRASTE) {
+        unsigned int corte = (unsigned int)(total * CONTRASTE_CORTE);
+        unsigned int acum = 0;
+        int baixo = 0, alto = 255;
+
+        while (baixo < 255 && (acum += hist[baixo]) <= corte) baixo++;
+        acum = 0;
+        while (alto > 0 && (acum += hist[alto]) <= corte) alto--;
+
+        if (alto > baixo) {
+            for (int v = 0; v < 256; v++) {
+                int y = (v - baixo) * 255 / (alto - baixo);
+                lut[v] = y < 0 ? 0 : (y > 255 ? 255 : y);
+            }
+        }
+    } else if (modo == TOM_GAMA) {
+        for (int v = 0; v < 256; v++) {
+            lut[v] = (unsigned char)(255.0 * pow(v / 255.0, 1.0 / gama) + 0.5);
+        }
+    } else if (modo == TOM_EQUALIZACAO) {
+        unsigned int cdf = 0, cdf_min = 0;
+        for (int v = 0; v < 256; v++) {
+            if (cdf_min == 0) cdf_min = hist[v];
+            cdf += hist[v];
+            if ((unsigned int)total > cdf_min) {
+                lut[v] = (unsigned char)(((unsigned long long)(cdf - cdf_min) * 255 +
+                                          (total - cdf_min) / 2) / (total - cdf_min));
+            }
+        }
+    }
+}
+
+// Calcula a LUT da imagem atual em imagem_backup conforme a curva escolhida
+void preparar_tom_imagem() {
+    lut_tom_ativa = 0;
+    if (modo_tom == TOM_NENHUM || imagem_backup == NULL) return;
+
+    unsigned int hist[256];
+    calcular_histograma(imagem_backup, TOTAL_PIXELS, hist);
+    construir_lut(modo_tom, gama_tom, hist, TOTAL_PIXELS, lut_tom);
+    lut_tom_ativa = 1;
+}
+
+// Aplica a LUT da imagem atual sobre 'n' pixels
+void aplicar_lut(const unsigned char *orig, unsigned char *dest, int n) {
+    for (int i = 0; i < n; i++) {
+        dest[i] = lut_tom[orig[i]];
+    }
+}
+
+// Escreve um retângulo do backup na VRAM, passando pela LUT quando ativa.
+// A LUT é aplicada direto na sombra da VRAM, que é de onde a escrita parte.
+void escrever_backup_rect(int dst_x, int dst_y, int w, int h, int src_x, int src_y) {
+    const unsigned char *orig = imagem_backup + src_y * LARGURA_IMAGEM + src_x;
+
+    if (w <= 0 || h <= 0) return;
+
+    for (int j = 0; j < h; j++) {
+        unsigned char *dest = vram_sombra + (dst_y + j) * LARGURA_IMAGEM + dst_x;
+        if (lut_tom_ativa) {
+            aplicar_lut(orig + j * LARGURA_IMAGEM, dest, w);
+        } else {
+            memcpy(dest, orig + j * LARGURA_IMAGEM, w);
+        }
+    }
+    escrever_rect_sombra(dst_x, dst_y, w, h);
+}
+
+// ================= TABELA INTEGRAL (SUMMED-AREA TABLE) =================
+
+// integral[y][x] = soma dos pixels de imagem_backup em [0, x) x [0, y), com borda de
+// zeros na linha e coluna 0; integral_quad guarda a soma dos quadrados para a variância.
+// A tabela é acumulada sob demanda até a última linha consultada.
+#define LARGURA_INTEGRAL (LARGURA_IMAGEM + 1)
+
+uint32_t integral[(ALTURA_IMAGEM + 1) * LARGURA_INTEGRAL];
+uint64_t integral_quad[(ALTURA_IMAGEM + 1) * LARGURA_INTEGRAL];
+
+// Linhas de imagem_backup já acumuladas na tabela
+int linhas_integral = 0;
+
+// Descarta a tabela a partir da linha y da imagem (as anteriores continuam válidas)
+void invalidar_tabela_integral(int y) {
+    if (y < linhas_integral) {
+        linhas_integral = y;
+    }
+}
+
+// Primeira linha em que dois quadros 320x240 diferem (ALTURA_IMAGEM se iguais)
+int primeira_linha_alterada(const unsigned char *a, const unsigned char *b) {
+    for (int y = 0; y < ALTURA_IMAGEM; y++) {
+        if (memcmp(a + y * LARGURA_IMAGEM, b + y * LARGURA_IMAGEM, LARGURA_IMAGEM) != 0) {
+            return y;
+        }
+    }
+    return ALTURA_IMAGEM;
+}
+
+// Acumula a linha y da imagem: prefixo da linha somado à linha de cima da tabela
+void acumular_linha_integral(int y) {
+    const unsigned char *linha = imagem_backup + y * LARGURA_IMAGEM;
+    const uint32_t *acima = integral + y * LARGURA_INTEGRAL;
+    const uint64_t *acima_q = integral_quad + y * LARGURA_INTEGRAL;
+    uint32_t *atual = integral + (y + 1) * LARGURA_INTEGRAL;
+    uint64_t *atual_q = integral_quad + (y + 1) * LARGURA_INTEGRAL;
+    uint32_t soma = 0, soma_q = 0;   // cabem em 32 bits dentro de uma linha
+
+    atual[0] = 0;
+    atual_q[0] = 0;
+
+    for (int x = 0; x < LARGURA_IMAGEM; x++) {
+        soma += linha[x];
+        soma_q += linha[x] * linha[x];
+        atual[x + 1] = acima[x + 1] + soma;
+        atual_q[x + 1] = acima_q[x + 1] + soma_q;
+    }
+}
+
+// Garante a tabela acumulada até a linha 'linhas' da imagem (exclusive)
+void garantir_tabela_integral(int linhas) {
+    if (imagem_backup == NULL) return;
+    while (linhas_integral < linhas) {
+        acumular_linha_integral(linhas_integral++);
+    }
+}
+
+// Soma dos pixels em [x, x+w) x [y, y+h), com o retângulo dentro da imagem
+uint32_t soma_regiao(int x, int y, int w, int h) {
+    garantir_tabela_integral(y + h);
+    const uint32_t *t0 = integral + y * LARGURA_INTEGRAL;
+    const uint32_t *t1 = integral + (y + h) * LARGURA_INTEGRAL;
+    return t1[x + w] - t1[x] - t0[x + w] + t0[x];
+}
+
+// Média e variância do retângulo [x, x+w) x [y, y+h) em tempo constante
+void estatisticas_regiao(int x, int y, int w, int h, double *media, double *variancia) {
+    garantir_tabela_integral(y + h);
+    const uint64_t *q0 = integral_quad + y * LARGURA_INTEGRAL;
+    const uint64_t *q1 = integral_quad + (y + h) * LARGURA_INTEGRAL;
+    double area = (double)w * h;
+    double m = soma_regiao(x, y, w, h) / area;
+
+    *media = m;
+    *variancia = (double)(q1[x + w] - q1[x] - q0[x + w] + q0[x]) / area - m * m;
+}
+
+// Reduz o retângulo (x, y, w, h) para larg x alt pixels por média de caixa;
+// cada pixel de saída custa uma consulta à tabela, qualquer que seja o fator
+void previa_regiao(int x, int y, int w, int h, int larg, int alt, unsigned char *dest) {
+    for (int j = 0; j < alt; j++) {
+        int y0 = y + j * h / alt;
+        int y1 = y + (j + 1) * h / alt;
+        for (int i = 0; i < larg; i++) {
+            int x0 = x + i * w / larg;
+            int x1 = x + (i + 1) * w / larg;
+            int area = (x1 - x0) * (y1 - y0);
+            dest[j * larg + i] = area > 0 ? (soma_regiao(x0, y0, x1 - x0, y1 - y0) + area / 2) / area : 0;
+        }
+    }
+}
+
+// ================= ENVIO PROGRESSIVO =================
+
+// Linhas escritas por chamada de avancar_envio_progressivo
+#define LINHAS_POR_FAIXA 8
+
+// Primeiro a prévia (só no v2): uma amostra por bloco 8x8, repetida pelo hardware na
+// horizontal. Depois as linhas em resolução total, cada uma escrita uma única vez, em
+// quatro passos entrelaçados: ao fim do passo i estão completas as linhas múltiplas de
+// linhas_completas[i] (1/8, 1/4, 1/2 e todas), e as demais ainda mostram a prévia.
+#define PASSO_PREVIA -1
+#define BLOCO_PREVIA 8
+static const int intervalo_passo[] = { 8, 8, 4, 2 };   // distância entre as linhas do passo
+static const int primeira_linha_passo[] = { 0, 4, 2, 1 };
+static const int linhas_completas[] = { 8, 4, 2, 1 };
+#define PASSOS_ENVIO 4
+
+// Envio de imagem_backup em andamento. Avança faixa a faixa, para quando chega
+// entrada do usuário e é descartado quando outro envio reescreve a tela.
+typedef struct {
+    int ativo;
+    int passo;     // PASSO_PREVIA ou índice em intervalo_passo
+    int linha;     // próxima linha do passo atual (índice dentro do passo)
+    double inicio; // tempo_ms() no início do envio
+} EnvioProgressivo;
+
+EnvioProgressivo envio = {0, 0, 0, 0.0};
+
+// Indica se já há entrada esperando para ser lida em fd (mouse ou teclado)
+int eventos_pendentes(int fd) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+// Começa a escrever imagem_backup na VRAM, descartando os passos do envio anterior
+void iniciar_envio_progressivo() {
+    envio.ativo = 1;
+    // Sem a repetição do protocolo v2 a prévia custaria um quadro inteiro: o v1 começa
+    // direto pelas linhas entrelaçadas, com o mesmo custo de um envio linha a linha
+    envio.passo = protocolo_vram == 2 ? PASSO_PREVIA : 0;
+    envio.linha = 0;
+    envio.inicio = tempo_ms();
+    iniciar_quadro_transferencia();
+}
+
+void cancelar_envio_progressivo() {
+    envio.ativo = 0;
+}
+
+// Linhas escritas pelo passo (ALTURA_IMAGEM na prévia)
+int linhas_do_passo(int passo) {
+    if (passo == PASSO_PREVIA) return ALTURA_IMAGEM;
+    return (ALTURA_IMAGEM - primeira_linha_passo[passo] + intervalo_passo[passo] - 1) / intervalo_passo[passo];
+}
+
+// Indica se a linha y já foi escrita em resolução total pelo envio em andamento
+int linha_completa(int y) {
+    int passo = y % 8 == 0 ? 0 : y % 8 == 4 ? 1 : y % 2 == 0 ? 2 : 3;
+    if (passo != envio.passo) return passo < envio.passo;
+    return (y - primeira_linha_passo[passo]) / intervalo_passo[passo] < envio.linha;
+}
+
+// Escreve a linha y com uma amostra por bloco (média do bloco, pela tabela integral);
+// o hardware repete cada amostra na horizontal
+void escrever_linha_blocos(int y, int bloco) {
+    unsigned char amostras[LARGURA_IMAGEM];
+    int n = LARGURA_IMAGEM / bloco;
+
+    previa_regiao(0, y - y % bloco, LARGURA_IMAGEM, bloco, n, 1, amostras);
+    if (lut_tom_ativa) {
+        aplicar_lut(amostras, amostras, n);
+    }
+    transferir_repetido(y * LARGURA_IMAGEM, amostras, n, bloco);
+}
+
+// Escreve a próxima faixa do passo atual; retorna 1 enquanto restarem passos
+int avancar_envio_progressivo() {
+    if (!envio.ativo) return 0;
+
+    int total = linhas_do_passo(envio.passo);
+    int fim = envio.linha + LINHAS_POR_FAIXA < total ? envio.linha + LINHAS_POR_FAIXA : total;
+
+    if (envio.passo == PASSO_PREVIA) {
+        for (int y = envio.linha; y < fim; y++) {
+            escrever_linha_blocos(y, BLOCO_PREVIA);
+        }
+    } else {
+        for (int i = envio.linha; i < fim; i++) {
+            int y = primeira_linha_passo[envio.passo] + i * intervalo_passo[envio.passo];
+            escrever_backup_rect(0, y, LARGURA_IMAGEM, 1, 0, y);
+        }
+    }
+
+    envio.linha = fim;
+    if (envio.linha < total) {
+        return 1;
+    }
+
+    envio.linha = 0;
+    if (envio.passo == PASSO_PREVIA) {
+        // A prévia vai inteira para a página oculta e é exibida de uma vez; as linhas em
+        // resolução total só refinam a mesma imagem e seguem na página já exibida
+        reenviar_falhas(1);
+        apresentar_pagina_oculta(0);
+        printf("   Prévia 1/%d na tela em %.1f ms\n", BLOCO_PREVIA, tempo_ms() - envio.inicio);
+    } else if (envio.passo == PASSOS_ENVIO - 1) {
+        envio.ativo = 0;
+        concluir_quadro_transferencia("Quadro");
+        printf("   Resolução total na tela em %.1f ms\n", tempo_ms() - envio.inicio);
+        return 0;
+    } else {
+        printf("   Linhas 1/%d em resolução total em %.1f ms\n",
+               linhas_completas[envio.passo], tempo_ms() - envio.inicio);
+    }
+    envio.passo++;
+    return 1;
+}
+
+// Continua o envio até o fim ou até haver entrada pendente em fd (fd = -1: até o fim).
+// Retorna 1 se o envio foi interrompido com passos restantes.
+int continuar_envio_progressivo(int fd) {
+    while (envio.ativo && !eventos_pendentes(fd)) {
+        avancar_envio_progressivo();
+    }
+    return envio.ativo;
+}
+
+// Descarta os passos restantes e escreve de uma vez, em resolução total, só as linhas
+// que ainda não a têm (em blocos de linhas vizinhas); usado quando a tela vai ser
+// ampliada ou rolada e a imagem precisa estar completa
+void terminar_envio_progressivo() {
+    if (!envio.ativo) return;
+
+    for (int y = 0; y < ALTURA_IMAGEM; ) {
+        if (linha_completa(y)) {
+            y++;
+            continue;
+        }
+        int h = 1;
+        while (y + h < ALTURA_IMAGEM && !linha_completa(y + h)) h++;
+        escrever_backup_rect(0, y, LARGURA_IMAGEM, h, 0, y);
+        y += h;
+    }
+
+    envio.ativo = 0;
+    concluir_quadro_transferencia("Quadro");
+    printf("   Resolução total na tela em %.1f ms\n", tempo_ms() - envio.inicio);
+}
+
+// ================= ROLAGEM (PAN) DA IMAGEM AMPLIADA =================
+
+// Posição lógica da janela 320x240 sobre imagem_backup. Com rolagem no hardware, a VRAM
+// é usada como anel: a coluna lógica lx fica sempre na coluna física lx mod 320 (idem
+// para as linhas), e Definir_Rolagem informa à VGA onde o anel começa. Sem ela, a
+// janela fica na origem e o arraste move a âncora do zoom (aplicar_arraste).
+int rolagem_x = 0, rolagem_y = 0;
+
+// VGA aceita EXT_ROLAGEM (detectado na inicialização)
+int rolagem_vram = 0;
+
+// Deslocamento máximo da janela: meia imagem para cada lado
+#define ROLAGEM_MAX_X (LARGURA_IMAGEM / 2)
+#define ROLAGEM_MAX_Y (ALTURA_IMAGEM / 2)
+
+int modulo(int a, int m) {
+    int r = a % m;
+    return r < 0 ? r + m : r;
+}
+
+// Volta a leitura da VRAM para a origem; quem chama reescreve o quadro inteiro em seguida.
+// Com duas páginas, a página em exibição continua deslocada até a troca, que zera a rolagem.
+void encerrar_rolagem() {
+    if (rolagem_x != 0 || rolagem_y != 0) {
+        rolagem_x = 0;
+        rolagem_y = 0;
+
+        if (paginas_vram == 2) {
+            rolagem_na_troca = 1;
+        } else {
+            Definir_Rolagem(0, 0);
+        }
+    }
+}
+
+// Monta uma linha lógica da janela: pixels do backup, preto fora da imagem
+void montar_linha_janela(int lx, int y, int larg, unsigned char *dest) {
+    if (y < 0 || y >= ALTURA_IMAGEM || lx >= LARGURA_IMAGEM || lx + larg <= 0) {
+        memset(dest, 0, larg);
+        return;
+    }
+
+    int esquerda = lx < 0 ? -lx : 0;
+    int fim = lx + larg > LARGURA_IMAGEM ? LARGURA_IMAGEM - lx : larg;
+
+    const unsigned char *orig = imagem_backup + y * LARGURA_IMAGEM + lx + esquerda;
+
+    memset(dest, 0, esquerda);
+    if (lut_tom_ativa) {
+        aplicar_lut(orig, dest + esquerda, fim - esquerda);
+    } else {
+        memcpy(dest + esquerda, orig, fim - esquerda);
+    }
+    memset(dest + fim, 0, larg - fim);
+}
+
+// Escreve o retângulo lógico [lx, lx+w) x [ly, ly+h) nas posições do anel,
+// dividido em até quatro retângulos físicos nos pontos de retorno
+void escrever_regiao_anel(int lx, int ly, int w, int h) {
+    for (int y0 = ly; y0 < ly + h; ) {
+        int py = modulo(y0, ALTURA_IMAGEM);
+        int alt = ly + h - y0;
+        if (alt > ALTURA_IMAGEM - py) alt = ALTURA_IMAGEM - py;
+
+        for (int x0 = lx; x0 < lx + w; ) {
+            int px = modulo(x0, LARGURA_IMAGEM);
+            int larg = lx + w - x0;
+            if (larg > LARGURA_IMAGEM - px) larg = LARGURA_IMAGEM - px;
+
+            for (int j = 0; j < alt; j++) {
+                montar_linha_janela(x0, y0 + j, larg, vram_sombra + (py + j) * LARGURA_IMAGEM + px);
+            }
+            escrever_rect_sombra(px, py, larg, alt);
+            x0 += larg;
+        }
+        y0 += alt;
+    }
+}
+
+// Move a janela para (novo_x, novo_y) enviando só as colunas e linhas que entram na tela.
+// Só é usada com rolagem na VGA; sem ela a janela fica sempre na origem.
+void rolar_janela(int novo_x, int novo_y) {
+    if (!rolagem_vram) return;
+
+    if (novo_x < -ROLAGEM_MAX_X) novo_x = -ROLAGEM_MAX_X;
+    if (novo_x > ROLAGEM_MAX_X) novo_x = ROLAGEM_MAX_X;
+    if (novo_y < -ROLAGEM_MAX_Y) novo_y = -ROLAGEM_MAX_Y;
+    if (novo_y > ROLAGEM_MAX_Y) novo_y = ROLAGEM_MAX_Y;
+
+    int dx = novo_x - rolagem_x;
+    int dy = novo_y - rolagem_y;
+    if (dx == 0 && dy == 0) return;
+
+    // As faixas novas supõem o resto da janela já em resolução total
+    terminar_envio_progressivo();
+
+    if (abs(dx) >= LARGURA_IMAGEM || abs(dy) >= ALTURA_IMAGEM) {
+        escrever_regiao_anel(novo_x, novo_y, LARGURA_IMAGEM, ALTURA_IMAGEM);
+    } else {
+        // Colunas novas com as linhas antigas, depois linhas novas já com as colunas novas
+        if (dx > 0) {
+            escrever_regiao_anel(rolagem_x + LARGURA_IMAGEM, rolagem_y, dx, ALTURA_IMAGEM);
+        } else if (dx < 0) {
+            escrever_regiao_anel(novo_x, rolagem_y, -dx, ALTURA_IMAGEM);
+        }
+        if (dy > 0) {
+            escrever_regiao_anel(novo_x, rolagem_y + ALTURA_IMAGEM, LARGURA_IMAGEM, dy);
+        } else if (dy < 0) {
+            escrever_regiao_anel(novo_x, novo_y, LARGURA_IMAGEM, -dy);
+        }
+    }
+
+    long restantes = reenviar_falhas(0);
+    if (restantes > 0) {
+        printf("\n⚠️  Rolagem: %ld pixels não confirmados\n", restantes);
+    }
+
+    rolagem_x = novo_x;
+    rolagem_y = novo_y;
+    Definir_Rolagem(modulo(novo_x, LARGURA_IMAGEM), modulo(novo_y, ALTURA_IMAGEM));
+}
+
+// Escreve imagem_backup inteira na VRAM (com a LUT de tons, se houver), da prévia em
+// blocos (v2) às linhas entrelaçadas em resolução total. Se o usuário digitar algo antes
+// do fim, os passos restantes continuam quando o programa voltar a esperar entrada.
+void enviar_backup_progressivo(const char *mensagem) {
+    // Aguardar hardware estar pronto
+    while(Flag_Done() == 0) {
+        usleep(1000);
+    }
+    encerrar_rolagem();
+
+    printf("%s", mensagem);
+    iniciar_envio_progressivo();
+    if (continuar_envio_progressivo(STDIN_FILENO)) {
+        printf("⏸️  Refinamento pausado; continua quando o sistema estiver ocioso\n");
+    }
+}
+
+// Troca a imagem em imagem_backup: atualiza a tabela integral e a LUT de tons e
+// descarta a região recortada da imagem anterior
+int definir_backup(const unsigned char *quadro) {
+    // Aloca buffer de backup se necessário
+    if (imagem_backup == NULL) {
+        imagem_backup = (unsigned char*)calloc(TOTAL_PIXELS, 1);
+    }
+
+    if (!imagem_backup) {
+        printf("ERRO: Falha ao alocar memória para backup!\n");
+        return -1;
+    }
+
+    if (quadro != imagem_backup) {
+        invalidar_tabela_integral(primeira_linha_alterada(imagem_backup, quadro));
+        memcpy(imagem_backup, quadro, TOTAL_PIXELS);
+    }
+
+    preparar_tom_imagem();
+
+    // Limpa região anterior ao carregar nova imagem
+    regiao_ativa = 0;
+    if (imagem_recorte != NULL) {
+        free(imagem_recorte);
+        imagem_recorte = NULL;
+    }
+
+    return 0;
+}
+
+// Função para enviar um quadro 320x240 já em memória para a FPGA
+int enviar_quadro(const unsigned char *quadro) {
+    if (definir_backup(quadro) != 0) {
+        return -1;
+    }
+
+    if (lut_tom_ativa) {
+        printf("🎚️  Tons: %s\n", nomes_tons[modo_tom]);
+    }
+
+    enviar_backup_progressivo("\nEnviando imagem...\n");
+    return 0;
+}
+
+// Função para carregar e enviar imagem (BMP, PGM ou RAW)
+int enviar_imagem(const char *filename) {
+    unsigned char *quadro = (unsigned char*)malloc(TOTAL_PIXELS);
+    if (!quadro) {
+        printf("ERRO: Falha ao alocar memória!\n");
+        return -1;
+    }
+
+    int status = carregar_quadro(filename, quadro, 1);
+    if (status == 0) {
+        status = enviar_quadro(quadro);
+    }
+
+    free(quadro);
+    return status;
+}
+
+// ================= PRÉ-PROCESSAMENTO EM LOTE =================
+
+#define MAX_TRABALHADORES 8
+
+enum { ESTAGIO_DECODIFICACAO, ESTAGIO_CINZA, ESTAGIO_RECORTE, ESTAGIO_PIRAMIDE, NUM_ESTAGIOS };
+
+static const char *nomes_estagios[NUM_ESTAGIOS] = {
+    "Decodificação", "Tons de cinza", "Recorte", "Pirâmide"
+};
+
+// Fila de tarefas de um trabalhador: o dono consome do fim, os outros roubam do início
+typedef struct {
+    int *tarefas;
+    int inicio;
+    int fim;
+    pthread_mutex_t trava;
+} FilaTrabalho;
+
+typedef struct LoteContexto LoteContexto;
+
+// Estado de cada thread do pool
+typedef struct {
+    int id;
+    LoteContexto *ctx;
+    int processadas;
+    int roubadas;
+    int falhas;
+    double tempo_estagio[NUM_ESTAGIOS];
+} Trabalhador;
+
+// Contexto compartilhado por todas as threads do lote
+struct LoteContexto {
+    const char *diretorio;
+    char **arquivos;
+    QuadroArmazenado *quadros;
+    FilaTrabalho filas[MAX_TRABALHADORES];
+    Trabalhador trabalhadores[MAX_TRABALHADORES];
+    int num_trabalhadores;
+};
+
+// Retira a próxima tarefa da própria fila ou, se vazia, rouba de outra
+int obter_tarefa(LoteContexto *ctx, Trabalhador *t) {
+    FilaTrabalho *propria = &ctx->filas[t->id];
+    int tarefa = -1;
+
+    pthread_mutex_lock(&propria->trava);
+    if (propria->fim > propria->inicio) {
+        tarefa = propria->tarefas[--propria->fim];
+    }
+    pthread_mutex_unlock(&propria->trava);
+    if (tarefa >= 0) return tarefa;
+
+    for (int i = 1; i < ctx->num_trabalhadores; i++) {
+        FilaTrabalho *vitima = &ctx->filas[(t->id + i) % ctx->num_trabalhadores];
+        pthread_mutex_lock(&vitima->trava);
+        if (vitima->fim > vitima->inicio) {
+            tarefa = vitima->tarefas[vitima->inicio++];
+        }
+        pthread_mutex_unlock(&vitima->trava);
+        if (tarefa >= 0) {
+            t->roubadas++;
+            return tarefa;
+        }
+    }
+
+    return -1;
+}
+
+// Executa todos os estágios para uma imagem do lote
+int processar_tarefa(LoteContexto *ctx, Trabalhador *t, int indice) {
+    char caminho[1024];
+    QuadroArmazenado *q = &ctx->quadros[indice];
+    ImagemDecodificada img;
+    double t0, t1;
+
+    snprintf(caminho, sizeof(caminho), "%s/%s", ctx->diretorio, ctx->arquivos[indice]);
+
+    t0 = tempo_ms();
+    if (decodificar_imagem(caminho, &img, 0) != 0) {
+        return -1;
+    }
+    t1 = tempo_ms();
+    t->tempo_estagio[ESTAGIO_DECODIFICACAO] += t1 - t0;
+
+    // Entradas já em tons de cinza seguem sem conversão
+    unsigned char *cinza = img.dados;
+    if (img.bits_por_pixel != 8) {
+        cinza = (unsigned char*)malloc((size_t)img.largura * img.altura);
+        if (!cinza) {
+            free(img.dados);
+            return -1;
+        }
+        converter_cinza(&img, cinza);
+        free(img.dados);
+    }
+    t0 = tempo_ms();
+    t->tempo_estagio[ESTAGIO_CINZA] += t0 - t1;
+
+    for (int n = 0; n < NIVEIS_PIRAMIDE; n++) {
+        q->niveis[n] = (unsigned char*)malloc(largura_nivel(n) * altura_nivel(n));
+        if (!q->niveis[n]) {
+            free(cinza);
+            return -1;
+        }
+    }
+    recortar_centralizado(cinza, img.largura, img.altura, q->niveis[0]);
+    free(cinza);
+    t1 = tempo_ms();
+    t->tempo_estagio[ESTAGIO_RECORTE] += t1 - t0;
+
+    gerar_piramide(q->niveis);
+    t->tempo_estagio[ESTAGIO_PIRAMIDE] += tempo_ms() - t1;
+
+    strncpy(q->nome, ctx->arquivos[indice], sizeof(q->nome) - 1);
+    q->nome[sizeof(q->nome) - 1] = '\0';
+    return 0;
+}
+
+// Laço principal de cada thread do pool
+void* trabalhador_lote(void *arg) {
+    Trabalhador *t = (Trabalhador*)arg;
+    LoteContexto *ctx = t->ctx;
+    int tarefa;
+
+    while ((tarefa = obter_tarefa(ctx, t)) >= 0) {
+        if (processar_tarefa(ctx, t, tarefa) == 0) {
+            t->processadas++;
+        } else {
+            t->falhas++;
+        }
+    }
+
+    return NULL;
+}
+
+int comparar_nomes(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Lista os arquivos de imagem (BMP, PGM, RAW) do diretório em ordem alfabética
+int listar_imagens(const char *diretorio, char ***arquivos) {
+    DIR *dir = opendir(diretorio);
+    if (!dir) {
+        printf("ERRO: Não foi possível abrir o diretório '%s'\n", diretorio);
+        return -1;
+    }
+
+    struct dirent *ent;
+    char **lista = NULL;
+    int total = 0, capacidade = 0;
+
+    while ((ent = readdir(dir)) != NULL) {
+        if (!tem_extensao(ent->d_name, ".bmp") && !tem_extensao(ent->d_name, ".pgm") &&
+            !tem_extensao(ent->d_name, ".raw")) continue;
+
+        if (total == capacidade) {
+            capacidade = capacidade ? capacidade * 2 : 64;
+            char **nova = (char**)realloc(lista, capacidade * sizeof(char*));
+            if (!nova) break;
+            lista = nova;
+        }
+        lista[total] = strdup(ent->d_name);
+        if (lista[total]) total++;
+    }
+    closedir(dir);
+
+    qsort(lista, total, sizeof(char*), comparar_nomes);
+    *arquivos = lista;
+    return total;
+}
+
+// Libera todos os quadros do armazenamento em memória
+void liberar_armazenamento() {
+    for (int i = 0; i < armazenamento.total; i++) {
+        for (int n = 0; n < NIVEIS_PIRAMIDE; n++) {
+            free(armazenamento.quadros[i].niveis[n]);
+        }
+    }
+    free(armazenamento.quadros);
+    armazenamento.quadros = NULL;
+    armazenamento.total = 0;
+}
+
+// Número de threads do pool: um por núcleo disponível
+int numero_trabalhadores() {
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nucleos < 1) nucleos = 1;
+    if (nucleos > MAX_TRABALHADORES) nucleos = MAX_TRABALHADORES;
+    return (int)nucleos;
+}
 
-    if (header.type != 0x4D42) {
-        printf("ERRO: Arquivo não é um BMP válido!\n");
-        fclose(file);
+// Pré-processa todas as imagens de um diretório em paralelo para o armazenamento de quadros
+int preprocessar_diretorio(const char *diretorio) {
+    char **arquivos = NULL;
+    int total = listar_imagens(diretorio, &arquivos);
+    if (total < 0) return -1;
+    if (total == 0) {
+        printf("❌ Nenhuma imagem (BMP/PGM/RAW) encontrada em '%s'\n", diretorio);
+        free(arquivos);
+        return -1;
+    }
+
+    LoteContexto *ctx = (LoteContexto*)calloc(1, sizeof(LoteContexto));
+    QuadroArmazenado *quadros = (QuadroArmazenado*)calloc(total, sizeof(QuadroArmazenado));
+    int *tarefas = (int*)malloc(total * sizeof(int));
+    if (!ctx || !quadros || !tarefas) {
+        printf("ERRO: Falha ao alocar memória!\n");
+        for (int i = 0; i < total; i++) free(arquivos[i]);
+        free(arquivos);
+        free(ctx);
+        free(quadros);
+        free(tarefas);
         return -1;
     }
 
-    printf("Dimensões: %dx%d pixels\n", info.width, info.height);
-    printf("Bits por pixel: %d\n", info.bits_per_pixel);
+    ctx->diretorio = diretorio;
+    ctx->arquivos = arquivos;
+    ctx->quadros = quadros;
+    ctx->num_trabalhadores = numero_trabalhadores();
+    if (ctx->num_trabalhadores > total) ctx->num_trabalhadores = total;
 
-    if (info.width != 320 || info.height != 240) {
-        printf("AVISO: Imagem com dimensões diferentes de 320x240!\n");
+    // Distribui faixas contíguas de imagens entre as filas; o roubo equilibra o resto
+    int n_trab = ctx->num_trabalhadores;
+    for (int w = 0; w < n_trab; w++) {
+        FilaTrabalho *f = &ctx->filas[w];
+        f->tarefas = tarefas;
+        f->inicio = (int)((long)total * w / n_trab);
+        f->fim = (int)((long)total * (w + 1) / n_trab);
+        pthread_mutex_init(&f->trava, NULL);
     }
+    for (int i = 0; i < total; i++) tarefas[i] = i;
 
-    fseek(file, header.offset, SEEK_SET);
+    printf("\n⚙️  Pré-processando %d imagens com %d threads...\n", total, n_trab);
 
-    int bytes_per_pixel = info.bits_per_pixel / 8;
-    int row_size = info.width * bytes_per_pixel;
-    int padding = (4 - (row_size % 4)) % 4;
+    pthread_t threads[MAX_TRABALHADORES];
+    double inicio = tempo_ms();
+
+    for (int w = 0; w < n_trab; w++) {
+        ctx->trabalhadores[w].id = w;
+        ctx->trabalhadores[w].ctx = ctx;
+        pthread_create(&threads[w], NULL, trabalhador_lote, &ctx->trabalhadores[w]);
+    }
+    for (int w = 0; w < n_trab; w++) {
+        pthread_join(threads[w], NULL);
+        pthread_mutex_destroy(&ctx->filas[w].trava);
+    }
+
+    double duracao = tempo_ms() - inicio;
+
+    // Compacta os quadros válidos no armazenamento global
+    liberar_armazenamento();
+    armazenamento.quadros = quadros;
+    for (int i = 0; i < total; i++) {
+        if (quadros[i].niveis[NIVEIS_PIRAMIDE - 1] != NULL && quadros[i].nome[0] != '\0') {
+            quadros[armazenamento.total++] = quadros[i];
+        } else {
+            for (int n = 0; n < NIVEIS_PIRAMIDE; n++) free(quadros[i].niveis[n]);
+        }
+    }
+
+    // Relatório de tempos por estágio (soma das threads)
+    double soma_estagios[NUM_ESTAGIOS] = {0};
+    int falhas = 0;
+    printf("\n📊 Pré-processamento concluído em %.1f ms\n", duracao);
+    for (int w = 0; w < n_trab; w++) {
+        Trabalhador *t = &ctx->trabalhadores[w];
+        printf("   Thread %d: %d imagens (%d roubadas)\n", w, t->processadas, t->roubadas);
+        falhas += t->falhas;
+        for (int e = 0; e < NUM_ESTAGIOS; e++) soma_estagios[e] += t->tempo_estagio[e];
+    }
+    for (int e = 0; e < NUM_ESTAGIOS; e++) {
+        printf("   %-14s %8.1f ms (%.2f ms/imagem)\n", nomes_estagios[e],
+               soma_estagios[e], soma_estagios[e] / total);
+    }
+    printf("✅ %d quadros no armazenamento", armazenamento.total);
+    if (falhas) printf(" (%d arquivos com falha)", falhas);
+    printf("\n");
+
+    for (int i = 0; i < total; i++) free(arquivos[i]);
+    free(arquivos);
+    free(tarefas);
+    free(ctx);
+    return 0;
+}
+
+// Envia para a FPGA um quadro do armazenamento
+int exibir_quadro_armazenado(int indice) {
+    if (indice < 0 || indice >= armazenamento.total) {
+        printf("❌ Quadro inexistente!\n");
+        return -1;
+    }
+    printf("Exibindo '%s'...\n", armazenamento.quadros[indice].nome);
+    return enviar_quadro(armazenamento.quadros[indice].niveis[0]);
+}
+
+// ================= MONITORAMENTO DE DIRETÓRIO =================
+
+// No v2, trechos da mesma linha separados por menos pixels iguais que isto vão num só
+// fluxo (abrir outro fluxo custa uma instrução de endereço base)
+#define INTERVALO_MINIMO_TRECHOS 4
+
+// Quadros trocados entre a thread que decodifica e o laço que exibe. A thread
+// decodifica em 'decodificando' e troca com 'pronto'; o laço troca 'pronto' com o
+// buffer que exibe. Um quadro pronto que não foi exibido a tempo é descartado.
+typedef struct {
+    pthread_mutex_t trava;
+    unsigned char *decodificando;
+    unsigned char *pronto;
+    int novo;                    // 'pronto' ainda não foi exibido
+    char nome[256];
+    double modificacao;          // relogio_ms() da última escrita do arquivo
+    double tempo_decodificacao;
+    int descartados;             // arquivos ignorados por já haver um mais novo
+    int fd_inotify;
+    int aviso[2];                // pipe thread → laço: um byte por quadro pronto; a thread
+                                 // fecha a ponta de escrita ao sair
+    int parar[2];                // pipe laço → thread: um byte ou o fechamento encerram a thread
+    const char *diretorio;
+} Monitoramento;
+
+// Relógio de parede em ms, comparável ao instante de modificação dos arquivos
+double relogio_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int eh_arquivo_imagem(const char *nome) {
+    return tem_extensao(nome, ".bmp") || tem_extensao(nome, ".pgm") || tem_extensao(nome, ".raw");
+}
+
+// Thread de decodificação: espera arquivos fechados ou movidos para o diretório e
+// decodifica só o mais recente de cada rajada
+void* trabalhador_monitoramento(void *arg) {
+    Monitoramento *m = (Monitoramento*)arg;
+    char eventos[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd[2] = { { m->fd_inotify, POLLIN, 0 }, { m->parar[0], POLLIN, 0 } };
+
+    while (poll(pfd, 2, -1) >= 0 && !(pfd[1].revents & (POLLIN | POLLHUP))) {
+        char nome[256] = "";
+        int arquivos = 0;
+        ssize_t n;
+
+        // Esvazia a fila do inotify; o último arquivo de imagem é o que será exibido
+        while ((n = read(m->fd_inotify, eventos, sizeof(eventos))) > 0) {
+            for (char *p = eventos; p < eventos + n; ) {
+                const struct inotify_event *ev = (const struct inotify_event*)p;
+                if (ev->len > 0 && eh_arquivo_imagem(ev->name)) {
+                    snprintf(nome, sizeof(nome), "%s", ev->name);
+                    arquivos++;
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        if (arquivos == 0) continue;
+
+        char caminho[512];
+        struct stat info;
+        snprintf(caminho, sizeof(caminho), "%s/%s", m->diretorio, nome);
+        double modificacao = relogio_ms();
+        if (stat(caminho, &info) == 0) {
+            modificacao = info.st_mtim.tv_sec * 1000.0 + info.st_mtim.tv_nsec / 1000000.0;
+        }
+
+        double inicio = tempo_ms();
+        if (carregar_quadro(caminho, m->decodificando, 0) != 0) {
+            printf("\n⚠️  Falha ao decodificar '%s'\n", nome);
+            continue;
+        }
+
+        pthread_mutex_lock(&m->trava);
+        unsigned char *troca = m->pronto;
+        m->pronto = m->decodificando;
+        m->decodificando = troca;
+        m->descartados += arquivos - 1 + m->novo;
+        m->novo = 1;
+        snprintf(m->nome, sizeof(m->nome), "%s", nome);
+        m->modificacao = modificacao;
+        m->tempo_decodificacao = tempo_ms() - inicio;
+        pthread_mutex_unlock(&m->trava);
+
+        if (write(m->aviso[1], "", 1) != 1) {
+            perror("\n❌ Erro ao avisar o laço de exibição");
+            break;
+        }
+    }
+    // Com a ponta de escrita fechada, o laço recebe POLLHUP se a thread sair antes dele
+    close(m->aviso[1]);
+    return NULL;
+}
+
+// Exibe o quadro enviando só os trechos de cada linha que diferem da sombra da página
+// de escrita (o quadro inteiro, se a sombra não for confiável). Com duas páginas, a
+// comparação é com o penúltimo quadro, que ainda está na página oculta.
+// Retorna os pixels enviados.
+long exibir_quadro_diferencas(const unsigned char *quadro, int *trechos) {
+    unsigned char linha[LARGURA_IMAGEM];
+    int intervalo = protocolo_vram == 2 ? INTERVALO_MINIMO_TRECHOS : 1;
 
-    // Aguardar hardware estar pronto
     while(Flag_Done() == 0) {
         usleep(1000);
     }
+    encerrar_rolagem();
+    cancelar_envio_progressivo();
+    definir_backup(quadro);
+    iniciar_quadro_transferencia();
+
+    int completo = !sombra_confiavel;
+    *trechos = 0;
+
+    for (int y = 0; y < ALTURA_IMAGEM; y++) {
+        const unsigned char *orig = imagem_backup + y * LARGURA_IMAGEM;
+        unsigned char *sombra = vram_sombra + y * LARGURA_IMAGEM;
+        unsigned int base = y * LARGURA_IMAGEM;
+
+        if (lut_tom_ativa) {
+            aplicar_lut(orig, linha, LARGURA_IMAGEM);
+        } else {
+            memcpy(linha, orig, LARGURA_IMAGEM);
+        }
+
+        for (int x = 0; x < LARGURA_IMAGEM; ) {
+            if (!completo && linha[x] == sombra[x]) {
+                x++;
+                continue;
+            }
+
+            // Estende o trecho enquanto a próxima diferença estiver a menos de 'intervalo'
+            int fim = x + 1;
+            for (int k = fim; k < LARGURA_IMAGEM && k - fim < intervalo; k++) {
+                if (completo || linha[k] != sombra[k]) fim = k + 1;
+            }
+
+            memcpy(sombra + x, linha + x, fim - x);
+            transferencia.pixels += fim - x;
+            transferencia.pixels_falhos += escrever_da_sombra(base + x, base + fim);
+            (*trechos)++;
+            x = fim;
+        }
+    }
+
+    if (reenviar_falhas(1) == 0 && completo) {
+        sombra_confiavel = 1;
+    }
+    apresentar_pagina_oculta(1);
+    return transferencia.pixels;
+}
 
-    printf("\nEnviando imagem...\n");
+// Modo de monitoramento: cada imagem nova ou regravada no diretório é exibida
+// assim que o arquivo é fechado, até o usuário pressionar ENTER
+int monitorar_diretorio(const char *diretorio) {
+    Monitoramento m;
+    unsigned char *exibindo;
+    pthread_t thread;
 
-    unsigned char *row_buffer = (unsigned char*)malloc(row_size);
-    if (!row_buffer) {
+    memset(&m, 0, sizeof(m));
+    m.diretorio = diretorio;
+    m.decodificando = (unsigned char*)malloc(TOTAL_PIXELS);
+    m.pronto = (unsigned char*)malloc(TOTAL_PIXELS);
+    exibindo = (unsigned char*)malloc(TOTAL_PIXELS);
+    if (!m.decodificando || !m.pronto || !exibindo) {
         printf("ERRO: Falha ao alocar memória!\n");
-        fclose(file);
+        free(m.decodificando);
+        free(m.pronto);
+        free(exibindo);
         return -1;
     }
 
-    // Aloca ou realoca buffer de backup
-    if (imagem_backup == NULL) {
-        imagem_backup = (unsigned char*)malloc(320 * 240);
+    m.fd_inotify = inotify_init1(IN_NONBLOCK);
+    if (m.fd_inotify < 0 || inotify_add_watch(m.fd_inotify, diretorio, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("❌ Erro ao monitorar diretório");
+        if (m.fd_inotify >= 0) close(m.fd_inotify);
+        free(m.decodificando);
+        free(m.pronto);
+        free(exibindo);
+        return -1;
     }
-    
-    if (!imagem_backup) {
-        printf("ERRO: Falha ao alocar memória para backup!\n");
-        free(row_buffer);
-        fclose(file);
+
+    if (pipe(m.aviso) != 0) {
+        perror("❌ Erro ao criar pipe de monitoramento");
+        close(m.fd_inotify);
+        free(m.decodificando);
+        free(m.pronto);
+        free(exibindo);
+        return -1;
+    }
+    if (pipe(m.parar) != 0) {
+        perror("❌ Erro ao criar pipe de monitoramento");
+        close(m.aviso[0]);
+        close(m.aviso[1]);
+        close(m.fd_inotify);
+        free(m.decodificando);
+        free(m.pronto);
+        free(exibindo);
         return -1;
     }
+    pthread_mutex_init(&m.trava, NULL);
+    pthread_create(&thread, NULL, trabalhador_monitoramento, &m);
 
-    int total_pixels = info.width * info.height;
-    int pixel_count = 0;
+    printf("\n╔════════════════════════════════════════════════╗\n");
+    printf("║        🛰️  MODO MONITORAMENTO DE DIRETÓRIO      ║\n");
+    printf("╚════════════════════════════════════════════════╝\n");
+    printf("  • Diretório: %s\n", diretorio);
+    printf("  • Imagens gravadas ali são exibidas automaticamente\n");
+    printf("  • ENTER: Sair\n");
+    printf("════════════════════════════════════════════════\n\n");
 
-    // BMP armazena de baixo para cima, então invertemos
-    for(int y = info.height - 1; y >= 0; y--) {
-        fseek(file, header.offset + y * (row_size + padding), SEEK_SET);
-        fread(row_buffer, 1, row_size, file);
+    struct pollfd pfd[2] = { { m.aviso[0], POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+    int erro = 0;
 
-        for(int x = 0; x < info.width; x++) {
-            unsigned char pixel_data;
-            
-            if (info.bits_per_pixel == 8) {
-                pixel_data = row_buffer[x];
-            } 
-            else if (info.bits_per_pixel == 24) {
-                int idx = x * 3;
-                unsigned char b = row_buffer[idx];
-                unsigned char g = row_buffer[idx + 1];
-                unsigned char r = row_buffer[idx + 2];
-                pixel_data = (r + g + b) / 3;
-            }
-            else {
-                printf("ERRO: Formato de pixel não suportado (%d bits)\n", info.bits_per_pixel);
-                free(row_buffer);
-                fclose(file);
-                return -1;
-            }
+    while (poll(pfd, 2, -1) >= 0) {
+        if (pfd[1].revents & (POLLIN | POLLHUP)) {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+            break;
+        }
+        if (!(pfd[0].revents & (POLLIN | POLLHUP))) continue;
 
-            int address = (info.height - 1 - y) * info.width + x;
-            
-            // Salva no backup
-            imagem_backup[address] = pixel_data;
-            
-            // Envia para FPGA
-            write_pixel(address, pixel_data);
-
-            pixel_count++;
-            
-            if(pixel_count % 500 == 0) {
-                float progresso = (pixel_count * 100.0) / total_pixels;
-                printf("\rProgresso: %d/%d pixels (%.1f%%)    ", 
-                       pixel_count, total_pixels, progresso);
-                fflush(stdout);
-            }
+        char avisos[64];
+        if (read(m.aviso[0], avisos, sizeof(avisos)) <= 0) {
+            printf("❌ A thread de monitoramento parou; saindo do modo monitoramento\n");
+            erro = -1;
+            break;
+        }
+
+        pthread_mutex_lock(&m.trava);
+        if (!m.novo) {
+            pthread_mutex_unlock(&m.trava);
+            continue;
+        }
+        unsigned char *troca = exibindo;
+        exibindo = m.pronto;
+        m.pronto = troca;
+        m.novo = 0;
+        char nome[256];
+        snprintf(nome, sizeof(nome), "%s", m.nome);
+        double modificacao = m.modificacao;
+        double decodificacao = m.tempo_decodificacao;
+        int descartados = m.descartados;
+        m.descartados = 0;
+        pthread_mutex_unlock(&m.trava);
+
+        double inicio = tempo_ms();
+        int trechos;
+        long pixels = exibir_quadro_diferencas(exibindo, &trechos);
+
+        printf("🛰️  %s: %ld pixels em %d trecho(s) | decodificação %.1f ms, envio %.1f ms, latência %.0f ms\n",
+               nome, pixels, trechos, decodificacao, tempo_ms() - inicio, relogio_ms() - modificacao);
+        if (paginas_vram == 2) {
+            printf("   📄 Página %d exibida (troca em %.1f ms)\n", pagina_exibida, ultima_troca_ms);
+        }
+        if (descartados > 0) {
+            printf("   %d arquivo(s) mais antigo(s) ignorado(s)\n", descartados);
+        }
+        if (transferencia.num_faixas > 0) {
+            printf("   ⚠️  %d faixa(s) de pixels não confirmadas\n", transferencia.num_faixas);
         }
     }
 
-    printf("\rProgresso: %d/%d pixels (100.0%%)    \n", total_pixels, total_pixels);
-    printf("Imagem enviada com sucesso!\n");
+    if (write(m.parar[1], "", 1) != 1) {
+        perror("❌ Erro ao parar a thread de monitoramento");
+        erro = -1;
+    }
+    close(m.parar[1]);   // sem o byte, o fechamento também acorda a thread
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&m.trava);
+    close(m.aviso[0]);
+    close(m.parar[0]);
+    close(m.fd_inotify);
+    free(m.decodificando);
+    free(m.pronto);
+    free(exibindo);
 
-    free(row_buffer);
-    fclose(file);
-    
-    // Limpa região anterior ao carregar nova imagem
-    regiao_ativa = 0;
-    if (imagem_recorte != NULL) {
-        free(imagem_recorte);
-        imagem_recorte = NULL;
+    if (erro) {
+        printf("❌ Monitoramento encerrado com erro\n");
+    } else {
+        printf("✅ Monitoramento encerrado\n");
     }
-    
-    return 0;
+    return erro;
 }
 
 // Função para restaurar imagem completa na memória do FPGA
 void restaurar_imagem_completa() {
     if (imagem_backup == NULL) return;
-    
-    while(Flag_Done() == 0) {
-        usleep(1000);
-    }
-    
-    printf("\n🔄 Restaurando imagem completa...\n");
-    for (int i = 0; i < 76800; i++) {
-        write_pixel(i, imagem_backup[i]);
-        if (i % 5000 == 0) {
-            printf("\rProgresso: %.1f%%", (i * 100.0f) / 76800.0f);
-            fflush(stdout);
-        }
-    }
-    printf("\r✅ Imagem completa restaurada! (100%%)    \n");
+
+    enviar_backup_progressivo("\n🔄 Restaurando imagem completa...\n");
 }
 
 // Função para aplicar recorte centralizado
@@ -222,41 +2063,26 @@ void aplicar_recorte_centralizado() {
     while(Flag_Done() == 0) {
         usleep(1000);
     }
+    encerrar_rolagem();
+    cancelar_envio_progressivo();
+    iniciar_quadro_transferencia();
     
     printf("\n🖼️  Aplicando recorte centralizado...\n");
     
-    int pixels_processados = 0;
-    int total_pixels = 320 * 240;
-    
-    for (int y_dest = 0; y_dest < 240; y_dest++) {
-        for (int x_dest = 0; x_dest < 320; x_dest++) {
-            int address = y_dest * 320 + x_dest;
-            
-            int x_regiao = x_dest - offset_centro_x;
-            int y_regiao = y_dest - offset_centro_y;
-            
-            if (x_regiao >= 0 && x_regiao < largura_regiao &&
-                y_regiao >= 0 && y_regiao < altura_regiao) {
-                
-                int x_orig = regiao_x_min + x_regiao;
-                int y_orig = regiao_y_min + y_regiao;
-                int addr_orig = y_orig * 320 + x_orig;
-                
-                write_pixel(address, imagem_backup[addr_orig]);
-            } else {
-                write_pixel(address, 0);
-            }
-            
-            pixels_processados++;
-            if (pixels_processados % 2000 == 0) {
-                float progresso = (pixels_processados * 100.0f) / total_pixels;
-                printf("\rProgresso: %.1f%%    ", progresso);
-                fflush(stdout);
-            }
-        }
-    }
+    // Região centralizada, copiada direto do backup
+    escrever_backup_rect(offset_centro_x, offset_centro_y, largura_regiao, altura_regiao,
+                         regiao_x_min, regiao_y_min);
+    
+    // Bordas pretas: faixas acima e abaixo, depois laterais da região
+    preencher_rect(0, 0, 320, offset_centro_y, 0);
+    preencher_rect(0, offset_centro_y + altura_regiao,
+                   320, 240 - offset_centro_y - altura_regiao, 0);
+    preencher_rect(0, offset_centro_y, offset_centro_x, altura_regiao, 0);
+    preencher_rect(offset_centro_x + largura_regiao, offset_centro_y,
+                   320 - offset_centro_x - largura_regiao, altura_regiao, 0);
     
     printf("\r✅ Recorte aplicado! (100%%)    \n");
+    concluir_quadro_transferencia("Recorte");
 }
 
 // Função para centralizar região selecionada e pintar resto de preto
@@ -303,6 +2129,10 @@ int aplicar_mascara_regiao(unsigned char* imagem_completa,
     }
     
     printf("📦 Dimensões da região: %dx%d pixels\n", largura_regiao, altura_regiao);
+
+    double media, variancia;
+    estatisticas_regiao(x_min, y_min, largura_regiao, altura_regiao, &media, &variancia);
+    printf("📊 Média: %.1f | Desvio padrão: %.1f\n", media, sqrt(variancia > 0 ? variancia : 0));
     
     // Salva as coordenadas da região
     regiao_x_min = x_min;
@@ -346,6 +2176,8 @@ void processar_selecao_regiao(int fd) {
     Enviar_Coordenadas(acum_x, acum_y);
 
     while (1) {
+        // Com o mouse parado, segue refinando a imagem em segundo plano
+        continuar_envio_progressivo(fd);
         read(fd, &ev, sizeof(struct input_event));
         int atualizar_coord = 0;
 
@@ -413,7 +2245,159 @@ void processar_selecao_regiao(int fd) {
     }
 }
 
+// ================= GRADE DE MINIATURAS =================
+
+// Grade 4x4 de miniaturas 80x60 (nível 2 da pirâmide) ocupando a tela 320x240
+#define GRADE_COLUNAS 4
+#define GRADE_LINHAS 4
+#define MINIATURAS_POR_GRADE (GRADE_COLUNAS * GRADE_LINHAS)
+#define NIVEL_MINIATURA 2
+
+// Escreve uma página da grade direto das miniaturas guardadas no armazenamento
+int enviar_grade(int pagina) {
+    int larg = largura_nivel(NIVEL_MINIATURA);
+    int alt = altura_nivel(NIVEL_MINIATURA);
+    int primeiro = pagina * MINIATURAS_POR_GRADE;
+    int exibidas = 0;
+
+    while(Flag_Done() == 0) {
+        usleep(1000);
+    }
+    encerrar_rolagem();
+    cancelar_envio_progressivo();
+    iniciar_quadro_transferencia();
+
+    for (int i = 0; i < MINIATURAS_POR_GRADE; i++) {
+        int indice = primeiro + i;
+        int x = (i % GRADE_COLUNAS) * larg;
+        int y = (i / GRADE_COLUNAS) * alt;
+
+        if (indice < armazenamento.total) {
+            transferir_rect(x, y, larg, alt, armazenamento.quadros[indice].niveis[NIVEL_MINIATURA], larg);
+            exibidas++;
+        } else {
+            preencher_rect(x, y, larg, alt, 0);
+        }
+    }
+
+    concluir_quadro_transferencia("Grade");
+    return exibidas;
+}
+
+// Converte a posição do cursor na tela 640x480 no índice da miniatura clicada
+int miniatura_na_posicao(int pagina, int cursor_x, int cursor_y) {
+    // A imagem 320x240 está centralizada na tela 640x480
+    int x = cursor_x - (640 - LARGURA_IMAGEM) / 2;
+    int y = cursor_y - (480 - ALTURA_IMAGEM) / 2;
+
+    if (x < 0 || x >= LARGURA_IMAGEM || y < 0 || y >= ALTURA_IMAGEM) return -1;
+
+    int coluna = x / largura_nivel(NIVEL_MINIATURA);
+    int linha = y / altura_nivel(NIVEL_MINIATURA);
+    int indice = pagina * MINIATURAS_POR_GRADE + linha * GRADE_COLUNAS + coluna;
+
+    return indice < armazenamento.total ? indice : -1;
+}
+
+// Modo grade: navega pelas páginas de miniaturas e abre a imagem clicada
+void grade_miniaturas(int fd) {
+    struct input_event ev;
+    int screen_width = 640;
+    int screen_height = 480;
+    int acum_x = screen_width / 2;
+    int acum_y = screen_height / 2;
+    int pagina = 0;
+    int paginas = (armazenamento.total + MINIATURAS_POR_GRADE - 1) / MINIATURAS_POR_GRADE;
+
+    printf("\n╔════════════════════════════════════════════════╗\n");
+    printf("║          🗂️  MODO GRADE DE MINIATURAS          ║\n");
+    printf("╚════════════════════════════════════════════════╝\n");
+    printf("  • Botão ESQUERDO: Abre a miniatura clicada\n");
+    printf("  • Scroll: Página anterior / próxima\n");
+    printf("  • Botão DIREITO: Sair\n");
+    printf("════════════════════════════════════════════════\n\n");
+
+    enviar_grade(pagina);
+    printf("📄 Página %d/%d\n", pagina + 1, paginas);
+
+    Enviar_Coordenadas(acum_x, acum_y);
+
+    while (1) {
+        read(fd, &ev, sizeof(struct input_event));
+        int atualizar_coord = 0;
+
+        if (ev.type == EV_REL && ev.code == REL_X) {
+            acum_x += ev.value;
+            if (acum_x < 0) acum_x = 0;
+            if (acum_x >= screen_width) acum_x = screen_width - 1;
+            atualizar_coord = 1;
+        }
+
+        if (ev.type == EV_REL && ev.code == REL_Y) {
+            acum_y += ev.value;
+            if (acum_y < 0) acum_y = 0;
+            if (acum_y >= screen_height) acum_y = screen_height - 1;
+            atualizar_coord = 1;
+        }
+
+        if (atualizar_coord) {
+            Enviar_Coordenadas(acum_x, acum_y);
+        }
+
+        if (ev.type == EV_REL && ev.code == REL_WHEEL && paginas > 1) {
+            pagina = (pagina + (ev.value < 0 ? 1 : paginas - 1)) % paginas;
+            enviar_grade(pagina);
+            printf("📄 Página %d/%d\n", pagina + 1, paginas);
+        }
+
+        if (ev.type == EV_KEY && ev.code == BTN_LEFT && ev.value == 1) {
+            int indice = miniatura_na_posicao(pagina, acum_x, acum_y);
+            if (indice >= 0) {
+                if (exibir_quadro_armazenado(indice) == 0) {
+                    Reset();
+                }
+                break;
+            }
+        }
+
+        if (ev.type == EV_KEY && ev.code == BTN_RIGHT && ev.value == 1) {
+            printf("\n❌ Grade fechada\n");
+            if (imagem_backup != NULL) {
+                restaurar_imagem_completa();
+            }
+            break;
+        }
+    }
+}
+
 // Função de zoom com controle automático de recorte e escolha de operação
+// Aplica o arraste acumulado (contagens do mouse, divididas pela escala do zoom); o resto
+// menor que um pixel fica para o próximo relatório. Com rolagem na VGA a janela rola pelo
+// anel da VRAM; sem ela a imagem inteira já está na VRAM e o arraste só move a âncora do
+// zoom (2 pixels de tela por pixel da VRAM), sem escrever nada.
+void aplicar_arraste(int *arraste_x, int *arraste_y, int nivel_zoom, int *acum_x, int *acum_y) {
+    int fator = 1 << nivel_zoom;
+    int passo_x = *arraste_x / fator;
+    int passo_y = *arraste_y / fator;
+    *arraste_x -= passo_x * fator;
+    *arraste_y -= passo_y * fator;
+
+    if (rolagem_vram) {
+        rolar_janela(rolagem_x - passo_x, rolagem_y - passo_y);
+        printf("\rRolagem: X=%4d, Y=%4d | Zoom: %dx    ", rolagem_x, rolagem_y, fator);
+    } else {
+        *acum_x -= 2 * passo_x;
+        *acum_y -= 2 * passo_y;
+        if (*acum_x < 0) *acum_x = 0;
+        if (*acum_x >= 2 * LARGURA_IMAGEM) *acum_x = 2 * LARGURA_IMAGEM - 1;
+        if (*acum_y < 0) *acum_y = 0;
+        if (*acum_y >= 2 * ALTURA_IMAGEM) *acum_y = 2 * ALTURA_IMAGEM - 1;
+        Enviar_Coordenadas(*acum_x, *acum_y);
+        printf("\rÂncora: X=%3d, Y=%3d | Zoom: %dx    ", *acum_x, *acum_y, fator);
+    }
+    fflush(stdout);
+}
+
 void zoom_com_mouse(int fd) {
     struct input_event ev;
     printf("\n╔════════════════════════════════════════════════╗\n");
@@ -462,6 +2446,7 @@ void zoom_com_mouse(int fd) {
     printf("  • Mova o mouse para posicionar cursor\n");
     printf("  • Scroll UP: Zoom IN (dinâmico)\n");
     printf("  • Scroll DOWN: Zoom OUT (dinâmico)\n");
+    printf("  • Botão DIREITO + arrastar: Move a imagem ampliada\n");
     printf("  • Botão ESQUERDO: Reset + Sair\n");
     if (regiao_ativa) {
         printf("  • RECORTE: Zoom OUT até 320x240 → ORIGINAL\n");
@@ -477,6 +2462,12 @@ void zoom_com_mouse(int fd) {
     int acum_y = screen_height / 2;
     int modo_recorte = regiao_ativa;
     
+    // Nível de zoom IN aplicado pelo hardware (cada nível dobra a escala)
+    int nivel_zoom = 0;
+    // Arraste com o botão direito e movimento acumulado ainda não enviado
+    int arrastando = 0;
+    int arraste_x = 0, arraste_y = 0;
+    
     int largura_recorte_original = 0;
     int altura_recorte_original = 0;
     if (regiao_ativa) {
@@ -484,6 +2475,10 @@ void zoom_com_mouse(int fd) {
         altura_recorte_original = regiao_y_max - regiao_y_min + 1;
     }
 
+    // A ampliação mostra a imagem em detalhe: as linhas que faltam vão já em resolução
+    // total, antes do primeiro zoom (o Reset das retentativas ainda é permitido)
+    terminar_envio_progressivo();
+    zoom_ativo = 1;
     Enviar_Coordenadas(acum_x, acum_y);
     printf("Posição inicial: X=%d, Y=%d\n", acum_x, acum_y);
     if (modo_recorte) {
@@ -496,6 +2491,13 @@ void zoom_com_mouse(int fd) {
         read(fd, &ev, sizeof(struct input_event));
         int atualizar_coord = 0;
 
+        // Durante o arraste o cursor (âncora do zoom) fica parado e o movimento rola a imagem
+        if (arrastando && ev.type == EV_REL && (ev.code == REL_X || ev.code == REL_Y)) {
+            if (ev.code == REL_X) arraste_x += ev.value;
+            else arraste_y += ev.value;
+            continue;
+        }
+
         if (ev.type == EV_REL && ev.code == REL_X) {
             acum_x += ev.value;
             if (acum_x < 0) acum_x = 0;
@@ -518,11 +2520,35 @@ void zoom_com_mouse(int fd) {
             fflush(stdout);
         }
 
+        // Aplica o arraste acumulado no fim de cada relatório do mouse; se já houver
+        // outro relatório na fila, continua acumulando para não enviar passos intermediários
+        if (arrastando && ev.type == EV_SYN && ev.code == SYN_REPORT &&
+            (arraste_x != 0 || arraste_y != 0) && !eventos_pendentes(fd)) {
+            aplicar_arraste(&arraste_x, &arraste_y, nivel_zoom, &acum_x, &acum_y);
+        }
+
+        if (ev.type == EV_KEY && ev.code == BTN_RIGHT) {
+            if (ev.value == 1 && nivel_zoom > 0 && !modo_recorte) {
+                arrastando = 1;
+                arraste_x = 0;
+                arraste_y = 0;
+            } else if (ev.value == 0 && arrastando) {
+                // O movimento que ainda esperava o fim da fila vale até a soltura do botão
+                if (arraste_x != 0 || arraste_y != 0) {
+                    aplicar_arraste(&arraste_x, &arraste_y, nivel_zoom, &acum_x, &acum_y);
+                }
+                arrastando = 0;
+            }
+        }
+
         if (ev.type == EV_KEY && ev.code == BTN_LEFT && ev.value == 1) {
             printf("\n🔄 Botão esquerdo pressionado. Resetando para imagem original...\n");
+            // O zoom vai ser desfeito pelo Reset abaixo; a restauração já pode resetar
+            zoom_ativo = 0;
             restaurar_imagem_completa();
             regiao_ativa = 0;
             modo_recorte = 0;
+            nivel_zoom = 0;
             Reset();
             printf("✅ Imagem restaurada! Saindo do zoom...\n");
             verification = 0;
@@ -532,6 +2558,11 @@ void zoom_com_mouse(int fd) {
         if (ev.type == EV_REL && ev.code == REL_WHEEL) {
             // ========== ZOOM IN ==========
             if (ev.value > 0) {
+                // No limite máximo o hardware ignora o zoom IN e o nível não muda
+                if (Flag_Max() == 0) {
+                    nivel_zoom++;
+                }
+
                 // Aplica o tipo de zoom IN escolhido no início
                 if (tipo_zoom_in == 1) {
                     Vizinho_Prox();
@@ -546,12 +2577,17 @@ void zoom_com_mouse(int fd) {
                         printf("\n🔄 Tamanho do recorte atingido! Voltando para modo RECORTE...\n");
                         aplicar_recorte_centralizado();
                         modo_recorte = 1;
+                        nivel_zoom = 0;
                         Reset();
                     }
                 }
             } 
             // ========== ZOOM OUT ==========
             else if (ev.value < 0) {
+                if (Flag_Min() == 0) {
+                    nivel_zoom--;
+                }
+
                 // Aplica o tipo de zoom OUT escolhido no início
                 if (tipo_zoom_out == 1) {
                     Media();
@@ -562,14 +2598,28 @@ void zoom_com_mouse(int fd) {
                 // Verifica se atingiu 320x240 APÓS aplicar o zoom out
                 usleep(50000);
                 if (Flag_Min() != 0) {
+                    nivel_zoom = 0;
                     if (modo_recorte && regiao_ativa) {
                         printf("\n🔄 Tamanho 320x240 atingido! Mudando para modo ORIGINAL...\n");
                         restaurar_imagem_completa();
                         modo_recorte = 0;
+                        nivel_zoom = 0;
                         Reset();
                     }
                 }
-            } 
+
+                // De volta à escala original: a janela retorna à origem
+                if (nivel_zoom == 0) {
+                    rolar_janela(0, 0);
+                }
+            }
+
+            // Sem zoom não há o que arrastar, mesmo com o botão direito ainda pressionado
+            if (nivel_zoom == 0) {
+                arrastando = 0;
+                arraste_x = 0;
+                arraste_y = 0;
+            }
         }
     }
 }
@@ -587,9 +2637,25 @@ int main() {
         printf("❌ ERRO ao iniciar API!\n");
         return 1;
     }
-    printf("✅ API em FUNCIONAMENTO!\n\n");
+    printf("✅ API em FUNCIONAMENTO!\n");
+    protocolo_vram = Detectar_Protocolo();
+    printf("📡 Protocolo da VRAM: v%d\n", protocolo_vram);
+    paginas_vram = Detectar_Paginas();
+    if (paginas_vram == 2) {
+        Definir_Pagina_Escrita(0);
+        Apresentar_Pagina(0, 0);
+    }
+    printf("📄 Páginas da VRAM: %d\n", paginas_vram);
+    rolagem_vram = Detectar_Rolagem();
+    printf("🧭 Rolagem na VGA: %s\n\n", rolagem_vram ? "sim" : "não (o arraste move a âncora do zoom)");
+
+    // O dispositivo do mouse pode ser trocado pela variável de ambiente MOUSE_DEV
+    const char *mouse = getenv("MOUSE_DEV");
+    if (mouse == NULL) {
+        mouse = "/dev/input/event0";
+    }
 
-    fd = open("/dev/input/event0", O_RDONLY);
+    fd = open(mouse, O_RDONLY);
     if (fd == -1) {
         perror("❌ Erro ao abrir mouse");
         encerrarBib();
@@ -600,14 +2666,22 @@ int main() {
     Reset();
     
     do {
+        // Refina a imagem enviada enquanto o usuário não digita a próxima opção
+        continuar_envio_progressivo(STDIN_FILENO);
+
         printf("\n╔════════════════════════════════════════╗\n");
         printf("║          MENU PRINCIPAL                ║\n");
         printf("╠════════════════════════════════════════╣\n");
-        printf("║ 1. Carregar imagem BMP                 ║\n");
+        printf("║ 1. Carregar imagem (BMP/PGM/RAW)       ║\n");
         printf("║ 2. Selecionar e centralizar região     ║\n");
         printf("║ 3. Zoom com mouse                      ║\n");
         printf("║ 4. Resetar imagem original             ║\n");
-        printf("║ 5. Sair                                ║\n");
+        printf("║ 5. Pré-processar diretório (lote)      ║\n");
+        printf("║ 6. Exibir quadro pré-processado        ║\n");
+        printf("║ 7. Grade de miniaturas                 ║\n");
+        printf("║ 8. Ajuste de tons                      ║\n");
+        printf("║ 9. Monitorar diretório                 ║\n");
+        printf("║ 10. Sair                               ║\n");
         printf("╚════════════════════════════════════════╝\n");
         if (regiao_ativa) {
             printf("📌 Região recortada ativa: (%d,%d) → (%d,%d)\n", 
@@ -620,11 +2694,11 @@ int main() {
         switch(opcao) {
             case 1: {
                 char nome_arquivo[256];
-                printf("\n📁 Digite o nome do arquivo BMP (ex: imagem.bmp): ");
+                printf("\n📁 Digite o nome do arquivo (ex: imagem.bmp, imagem.pgm): ");
                 scanf("%s", nome_arquivo);
                 getchar(); // Limpa buffer
                 printf("Carregando '%s'...\n", nome_arquivo);
-                if (enviar_imagem_bmp(nome_arquivo) == 0) {
+                if (enviar_imagem(nome_arquivo) == 0) {
                     Reset();
                 } else {
                     printf("❌ Falha ao carregar imagem!\n");
@@ -660,7 +2734,93 @@ int main() {
                 }
                 break;
                 
-            case 5:
+            case 5: {
+                char diretorio[256];
+                printf("\n📂 Digite o diretório com as imagens: ");
+                scanf("%255s", diretorio);
+                getchar(); // Limpa buffer
+                preprocessar_diretorio(diretorio);
+                break;
+            }
+
+            case 6:
+                if (armazenamento.total == 0) {
+                    printf("\n❌ Nenhum quadro pré-processado (opção 5)!\n");
+                } else {
+                    int indice;
+                    for (int i = 0; i < armazenamento.total; i++) {
+                        printf("  %3d. %s\n", i + 1, armazenamento.quadros[i].nome);
+                    }
+                    printf("Quadro: ");
+                    scanf("%d", &indice);
+                    getchar(); // Limpa buffer
+                    if (exibir_quadro_armazenado(indice - 1) == 0) {
+                        Reset();
+                    }
+                }
+                break;
+
+            case 7:
+                if (armazenamento.total == 0) {
+                    printf("\n❌ Nenhum quadro pré-processado (opção 5)!\n");
+                } else {
+                    grade_miniaturas(fd);
+                }
+                break;
+
+            case 8: {
+                int modo;
+                printf("\n╔════════════════════════════════════╗\n");
+                printf("║      🎚️  ESCOLHA O AJUSTE DE TONS   ║\n");
+                printf("╠════════════════════════════════════╣\n");
+                printf("║ 0. Nenhum                          ║\n");
+                printf("║ 1. Contraste automático            ║\n");
+                printf("║ 2. Gama                            ║\n");
+                printf("║ 3. Equalização de histograma       ║\n");
+                printf("╚════════════════════════════════════╝\n");
+                printf("Opção: ");
+                scanf("%d", &modo);
+                getchar(); // Limpa buffer
+
+                if (modo < TOM_NENHUM || modo > TOM_EQUALIZACAO) {
+                    printf("❌ Opção inválida!\n");
+                    break;
+                }
+                if (modo == TOM_GAMA) {
+                    printf("Gama (ex: 2.2 clareia, 0.5 escurece): ");
+                    scanf("%lf", &gama_tom);
+                    getchar(); // Limpa buffer
+                    if (gama_tom <= 0.0) {
+                        printf("❌ Gama inválido! Usando 1.0.\n");
+                        gama_tom = 1.0;
+                    }
+                }
+                modo_tom = (ModoTom)modo;
+                printf("✅ Tons: %s\n", nomes_tons[modo_tom]);
+
+                // Reaplica na imagem atual mantendo o recorte, se houver
+                if (imagem_backup != NULL) {
+                    preparar_tom_imagem();
+                    if (regiao_ativa) {
+                        aplicar_recorte_centralizado();
+                    } else {
+                        restaurar_imagem_completa();
+                    }
+                    Reset();
+                }
+                break;
+            }
+
+            case 9: {
+                char diretorio[256];
+                printf("\n📂 Digite o diretório a monitorar: ");
+                scanf("%255s", diretorio);
+                getchar(); // Limpa buffer
+                monitorar_diretorio(diretorio);
+                break;
+            }
+
+            case 10:
                 printf("\n👋 Saindo...\n");
                 continuar = 0;
                 break;
@@ -680,6 +2840,8 @@ int main() {
     if (imagem_recorte != NULL) {
         free(imagem_recorte);
     }
+
+    liberar_armazenamento();
     
     close(fd);
     encerrarBib();